@@ -0,0 +1,261 @@
+// Bench/replay.cpp
+//
+// Drives a chat server from a capture written by `chat_server --capture`.
+// Every captured connection id gets its own TCP connection; packets are sent
+// in capture order, paced by their recorded arrival times.
+//
+// Usage: ./replay <capture-file> [host] [port] [--speed N|max]
+//
+//   --speed 1    replay in real time (default)
+//   --speed N    replay N times faster
+//   --speed max  send as fast as the server accepts
+//
+// Latency is measured for MESSAGE packets whose sender is also a member of
+// the target group: the time from send until the broadcast copy with the
+// same payload comes back on the sending connection.
+
+#include "../Shared/capture.h"
+#include "../Shared/protocol.h"
+#include "../Shared/utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct ReplayConn {
+    int sock = -1;
+    bool closed = false;
+    std::string rxBuf;                                         // partial packets
+    std::map<std::string, std::deque<Clock::time_point>> pending; // payload -> send times
+};
+
+static std::vector<CaptureRecord> loadCapture(const std::string& path) {
+    std::vector<CaptureRecord> records;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open " << path << "\n";
+        return records;
+    }
+
+    CaptureHeader hdr{};
+    in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr));
+    if (!in || std::memcmp(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != CAPTURE_VERSION || hdr.packetSize != sizeof(ChatPacket)) {
+        std::cerr << path << " is not a compatible capture file\n";
+        return records;
+    }
+
+    CaptureRecord rec{};
+    while (in.read(reinterpret_cast<char*>(&rec), sizeof(rec))) {
+        records.push_back(rec);
+    }
+    return records;
+}
+
+static int connectTo(const std::string& host, int port) {
+    int sock = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) <= 0 ||
+        connect(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        ::close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0]
+                  << " <capture-file> [host] [port] [--speed N|max]\n";
+        return 1;
+    }
+
+    std::string path = argv[1];
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    double speed = 1.0;   // 0 = max
+
+    int positional = 0;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--speed" && i + 1 < argc) {
+            std::string v = argv[++i];
+            speed = (v == "max") ? 0.0 : std::stod(v);
+        } else if (positional == 0) {
+            host = arg;
+            ++positional;
+        } else {
+            port = std::stoi(arg);
+        }
+    }
+
+    std::vector<CaptureRecord> records = loadCapture(path);
+    if (records.empty()) {
+        std::cerr << "Nothing to replay.\n";
+        return 1;
+    }
+
+    std::map<std::uint32_t, ReplayConn> conns;
+    std::mutex connMutex;
+    std::vector<double> latenciesUs;
+    std::atomic<bool> running{true};
+    std::atomic<std::uint64_t> received{0};
+
+    // ---- receiver: drains every connection and matches echoes ----
+    std::thread receiver([&] {
+        char buf[64 * 1024];
+        while (running) {
+            std::vector<pollfd> pfds;
+            std::vector<std::uint32_t> ids;
+            {
+                std::lock_guard<std::mutex> lock(connMutex);
+                for (auto& kv : conns) {
+                    if (kv.second.closed) continue;
+                    pfds.push_back(pollfd{kv.second.sock, POLLIN, 0});
+                    ids.push_back(kv.first);
+                }
+            }
+            if (pfds.empty()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            if (::poll(pfds.data(), pfds.size(), 10) <= 0) continue;
+
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(connMutex);
+            for (std::size_t i = 0; i < pfds.size(); ++i) {
+                if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                ReplayConn& c = conns[ids[i]];
+                ssize_t n = ::recv(c.sock, buf, sizeof(buf), MSG_DONTWAIT);
+                if (n <= 0) {
+                    c.closed = true;
+                    continue;
+                }
+                c.rxBuf.append(buf, static_cast<std::size_t>(n));
+
+                std::size_t off = 0;
+                while (c.rxBuf.size() - off >= sizeof(ChatPacket)) {
+                    ChatPacket pkt;
+                    std::memcpy(&pkt, c.rxBuf.data() + off, sizeof(pkt));
+                    off += sizeof(pkt);
+                    received++;
+                    if (pkt.type != ChatType::MESSAGE) continue;
+
+                    pkt.payload[sizeof(pkt.payload) - 1] = '\0';
+                    auto it = c.pending.find(pkt.payload);
+                    if (it == c.pending.end() || it->second.empty()) continue;
+                    latenciesUs.push_back(
+                        std::chrono::duration<double, std::micro>(
+                            now - it->second.front()).count());
+                    it->second.pop_front();
+                }
+                c.rxBuf.erase(0, off);
+            }
+        }
+    });
+
+    // ---- sender: replays records in capture order ----
+    std::uint64_t sent = 0;
+    std::uint64_t failed = 0;
+    std::uint64_t base = records.front().arrivalNs;
+    auto start = Clock::now();
+
+    for (const CaptureRecord& rec : records) {
+        if (speed > 0.0) {
+            // older captures may hold slightly out-of-order stamps; never
+            // let one wrap into a huge (or negative) sleep
+            std::int64_t delta = static_cast<std::int64_t>(rec.arrivalNs - base);
+            if (delta < 0) delta = 0;
+            auto offset = std::chrono::nanoseconds(
+                static_cast<std::int64_t>(static_cast<double>(delta) / speed));
+            std::this_thread::sleep_until(start + offset);
+        }
+
+        int sock;
+        {
+            std::lock_guard<std::mutex> lock(connMutex);
+            auto it = conns.find(rec.connId);
+            if (it == conns.end()) {
+                ReplayConn c;
+                c.sock = connectTo(host, port);
+                if (c.sock < 0) {
+                    std::cerr << "connect failed for conn " << rec.connId << "\n";
+                    c.closed = true;
+                }
+                it = conns.emplace(rec.connId, std::move(c)).first;
+            }
+            if (it->second.closed) {
+                failed++;
+                continue;
+            }
+            sock = it->second.sock;
+
+            if (rec.packet.type == ChatType::MESSAGE) {
+                char text[sizeof(rec.packet.payload)];
+                std::memcpy(text, rec.packet.payload, sizeof(text));
+                text[sizeof(text) - 1] = '\0';
+                it->second.pending[text].push_back(Clock::now());
+            }
+        }
+
+        if (send_all(sock, &rec.packet, sizeof(rec.packet))) {
+            sent++;
+        } else {
+            failed++;
+        }
+    }
+
+    auto sendDone = Clock::now();
+
+    // give the server a moment to flush the last broadcasts
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    running = false;
+    receiver.join();
+
+    for (auto& kv : conns) {
+        if (kv.second.sock >= 0) ::close(kv.second.sock);
+    }
+
+    double elapsed = std::chrono::duration<double>(sendDone - start).count();
+    std::sort(latenciesUs.begin(), latenciesUs.end());
+    auto pct = [&](double p) {
+        if (latenciesUs.empty()) return 0.0;
+        std::size_t idx = static_cast<std::size_t>(p * (latenciesUs.size() - 1));
+        return latenciesUs[idx];
+    };
+
+    std::cout << "=== Replay Results ===\n";
+    std::cout << "Capture: " << path << " (" << records.size() << " packets, "
+              << conns.size() << " connections)\n";
+    if (speed > 0.0) std::cout << "Speed: " << speed << "x\n";
+    else             std::cout << "Speed: max\n";
+    std::cout << "Sent: " << sent << "  failed: " << failed
+              << "  received: " << received.load() << "\n";
+    std::cout << "Elapsed: " << elapsed << " sec\n";
+    std::cout << "Throughput: " << (elapsed > 0 ? sent / elapsed : 0.0) << " pkt/sec\n";
+    std::cout << "Latency samples: " << latenciesUs.size() << "\n";
+    std::cout << "Latency p50: " << pct(0.50) << " us  p99: " << pct(0.99)
+              << " us  max: " << pct(1.0) << " us\n";
+    return 0;
+}
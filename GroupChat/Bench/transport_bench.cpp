@@ -0,0 +1,162 @@
+// Bench/transport_bench.cpp
+//
+// Compares the server's transports from one host: TCP loopback, the Unix
+// domain socket, and Unix socket + shared-memory rings.
+//
+// Usage: ./transport_bench [host] [port] [--unix <path>]
+//                          [--pings N] [--burst N]
+//
+// Start the server with the same --unix path and with admission limits high
+// enough not to throttle the burst, e.g.
+//
+//   ./chat_server 8080 --unix /tmp/groupchat.sock --conn-rate 1000000 --group-rate 1000000
+//
+// For each transport the bench joins its own group, then
+//   ping:  sends one message at a time and waits for its broadcast echo
+//          (round-trip latency through the server), and
+//   burst: queues N messages back-to-back and waits for all echoes
+//          (pipelined throughput).
+//
+// Output is CSV: transport,pings,rtt_avg_us,rtt_p50_us,rtt_p99_us,burst,burst_msgs_per_sec
+
+#include "../Client/async_client.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr auto kEchoTimeout = std::chrono::seconds(5);
+
+// Counts echoes of our own messages; everything else (join notices,
+// cache replay of earlier runs) is ignored by prefix.
+struct EchoWaiter {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::string prefix;
+    std::uint64_t seen = 0;
+
+    void onEvent(const ChatEvent& ev) {
+        if (ev.type != ChatType::MESSAGE) return;
+        if (ev.text.find(prefix) == std::string::npos) return;
+        std::lock_guard<std::mutex> lock(mtx);
+        ++seen;
+        cv.notify_one();
+    }
+
+    bool waitFor(std::uint64_t count) {
+        std::unique_lock<std::mutex> lock(mtx);
+        return cv.wait_for(lock, kEchoTimeout, [&] { return seen >= count; });
+    }
+};
+
+double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    std::size_t idx = static_cast<std::size_t>(p * (v.size() - 1));
+    return v[idx];
+}
+
+bool runOne(const std::string& name, std::uint16_t groupId,
+            const std::function<bool(AsyncChatClient&)>& connectFn,
+            int pings, int burst) {
+    AsyncChatClient client;
+    EchoWaiter waiter;
+    // a run-unique prefix keeps replayed messages from earlier runs out
+    waiter.prefix = name + "-" + std::to_string(Clock::now().time_since_epoch().count()) + "-";
+    client.onEvent([&waiter](const ChatEvent& ev) { waiter.onEvent(ev); });
+
+    if (!connectFn(client)) {
+        std::cerr << name << ": connect failed, skipping\n";
+        return false;
+    }
+    client.join(groupId, "bench-" + name);
+
+    std::uint64_t expected = 0;
+    std::vector<double> rttUs;
+    rttUs.reserve(static_cast<std::size_t>(pings));
+
+    for (int i = 0; i < pings; ++i) {
+        auto start = Clock::now();
+        client.sendMessage(groupId, waiter.prefix + "ping" + std::to_string(i));
+        if (!waiter.waitFor(++expected)) {
+            std::cerr << name << ": echo timed out after " << i << " pings\n";
+            client.close();
+            return false;
+        }
+        rttUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+
+    auto burstStart = Clock::now();
+    for (int i = 0; i < burst; ++i) {
+        client.sendMessage(groupId, waiter.prefix + "bulk" + std::to_string(i));
+    }
+    expected += static_cast<std::uint64_t>(burst);
+    bool burstDone = waiter.waitFor(expected);
+    double burstSec = std::chrono::duration<double>(Clock::now() - burstStart).count();
+    if (!burstDone) std::cerr << name << ": burst incomplete (throttled?)\n";
+
+    double avg = 0.0;
+    for (double v : rttUs) avg += v;
+    if (!rttUs.empty()) avg /= rttUs.size();
+
+    std::printf("%s,%d,%.1f,%.1f,%.1f,%d,%.0f\n", name.c_str(), pings, avg,
+                percentile(rttUs, 0.50), percentile(rttUs, 0.99), burst,
+                burstDone ? burst / burstSec : 0.0);
+    std::fflush(stdout);
+
+    client.leave(groupId);
+    client.close();
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    std::string unixPath;
+    int pings = 2000;
+    int burst = 20000;
+
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--unix" && i + 1 < argc) {
+            unixPath = argv[++i];
+        } else if (arg == "--pings" && i + 1 < argc) {
+            pings = std::stoi(argv[++i]);
+        } else if (arg == "--burst" && i + 1 < argc) {
+            burst = std::stoi(argv[++i]);
+        } else if (positional == 0) {
+            host = arg;
+            ++positional;
+        } else {
+            port = std::stoi(arg);
+        }
+    }
+
+    std::printf("transport,pings,rtt_avg_us,rtt_p50_us,rtt_p99_us,burst,burst_msgs_per_sec\n");
+
+    runOne("tcp", 901, [&](AsyncChatClient& c) { return c.connect(host, port); },
+           pings, burst);
+
+    if (unixPath.empty()) {
+        std::cerr << "no --unix path given; skipping unix and shm\n";
+        return 0;
+    }
+    runOne("unix", 902, [&](AsyncChatClient& c) { return c.connectUnix(unixPath); },
+           pings, burst);
+    runOne("shm", 903, [&](AsyncChatClient& c) { return c.connectShm(unixPath); },
+           pings, burst);
+    return 0;
+}
@@ -0,0 +1,388 @@
+#include "async_client.h"
+
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../Shared/shm_ring.h"
+#include "../Shared/utils.h"
+
+#ifdef MSG_NOSIGNAL
+static constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+static constexpr int kSendFlags = 0;
+#endif
+
+// enough for ~250 packets per recv()
+static constexpr std::size_t kReadChunk = 64 * 1024;
+
+static void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+AsyncChatClient::AsyncChatClient()
+    : sock_(-1), wakeFds_{-1, -1}, shm_(nullptr), running_(false), closeInLoop_(false) {}
+
+AsyncChatClient::~AsyncChatClient() {
+    // the I/O thread would return into a destroyed object
+    assert(ioThread_.get_id() != std::this_thread::get_id() &&
+           "AsyncChatClient destroyed from one of its callbacks");
+    close(0);
+}
+
+bool AsyncChatClient::connect(const std::string& host, int port) {
+    sock_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (sock_ < 0) {
+        perror("socket");
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(static_cast<std::uint16_t>(port));
+
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) <= 0) {
+        std::cerr << "Invalid address / Address not supported\n";
+        ::close(sock_);
+        sock_ = -1;
+        return false;
+    }
+
+    if (::connect(sock_, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        ::close(sock_);
+        sock_ = -1;
+        return false;
+    }
+
+    return startIo();
+}
+
+bool AsyncChatClient::connectUnix(const std::string& path) {
+    return openUnixSocket(path) && startIo();
+}
+
+bool AsyncChatClient::connectShm(const std::string& path) {
+    if (!openUnixSocket(path)) return false;
+    if (!attachShm()) {
+        ::close(sock_);
+        sock_ = -1;
+        return false;
+    }
+    return startIo();
+}
+
+bool AsyncChatClient::openUnixSocket(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Unix socket path too long\n";
+        return false;
+    }
+
+    sock_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock_ < 0) {
+        perror("socket");
+        return false;
+    }
+
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (::connect(sock_, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        ::close(sock_);
+        sock_ = -1;
+        return false;
+    }
+    return true;
+}
+
+// Creates the segment, hands its name to the server and waits for the ack.
+bool AsyncChatClient::attachShm() {
+    static std::atomic<unsigned> counter{0};
+    std::string name = "/groupchat-" + std::to_string(::getpid()) + "-" +
+                       std::to_string(counter++);
+
+    shm_ = shm_segment_map(name, true);
+    if (!shm_) {
+        perror("shm_open");
+        return false;
+    }
+
+    ChatPacket req{};
+    req.type      = ChatType::SHM_ATTACH;
+    req.timestamp = htonl(current_timestamp());
+    std::snprintf(req.payload, sizeof(req.payload), "%s", name.c_str());
+
+    // sleep on our ring so a successful ack (sent through it) also wakes us
+    shm_ring_prepare_sleep(shm_->toClient);
+    bool ok = send_all(sock_, &req, sizeof(req));
+    if (ok) {
+        pollfd pfd{sock_, POLLIN, 0};
+        ok = ::poll(&pfd, 1, 2000) > 0;
+    }
+
+    ChatPacket ack;
+    if (ok && !shm_ring_pop(shm_->toClient, ack)) {
+        // the server refused and answered on the socket instead
+        if (recv_all(sock_, &ack, sizeof(ack))) {
+            ack.payload[sizeof(ack.payload) - 1] = '\0';
+            std::cerr << "Server: " << ack.payload << "\n";
+        }
+        ok = false;
+    }
+    shm_->toClient.sleeping.store(0);
+
+    // the server has it mapped by now (or never will); keep /dev/shm clean
+    ::shm_unlink(name.c_str());
+    if (!ok) {
+        shm_segment_unmap(shm_);
+        shm_ = nullptr;
+    }
+    return ok;
+}
+
+bool AsyncChatClient::startIo() {
+    if (::pipe(wakeFds_) < 0) {
+        perror("pipe");
+        ::close(sock_);
+        sock_ = -1;
+        return false;
+    }
+    setNonBlocking(sock_);
+    setNonBlocking(wakeFds_[0]);
+    setNonBlocking(wakeFds_[1]);
+
+    running_ = true;
+    closeInLoop_ = false;
+    ioThread_ = std::thread(&AsyncChatClient::ioLoop, this);
+    return true;
+}
+
+void AsyncChatClient::close(int timeoutMs) {
+    // from a callback: the read functions still use the fds and the segment
+    // when we return, so ioLoop() releases them on its way out
+    if (ioThread_.get_id() == std::this_thread::get_id()) {
+        closeInLoop_ = true;
+        running_ = false;
+        return;
+    }
+
+    // give the I/O thread a chance to push out anything still queued
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeoutMs);
+    while (running_ && pendingSendBytes() > 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    running_ = false;
+    wake();
+    if (ioThread_.joinable()) ioThread_.join();
+    releaseConnection();
+}
+
+void AsyncChatClient::releaseConnection() {
+    if (sock_ >= 0)       { ::close(sock_);       sock_ = -1; }
+    if (wakeFds_[0] >= 0) { ::close(wakeFds_[0]); wakeFds_[0] = -1; }
+    if (wakeFds_[1] >= 0) { ::close(wakeFds_[1]); wakeFds_[1] = -1; }
+    shm_segment_unmap(shm_);
+    shm_ = nullptr;
+}
+
+bool AsyncChatClient::join(std::uint16_t groupId, const std::string& username) {
+    return queuePacket(ChatType::JOIN, groupId, username);
+}
+
+bool AsyncChatClient::leave(std::uint16_t groupId) {
+    return queuePacket(ChatType::LEAVE, groupId, "");
+}
+
+bool AsyncChatClient::sendMessage(std::uint16_t groupId, const std::string& text) {
+    return queuePacket(ChatType::MESSAGE, groupId, text);
+}
+
+bool AsyncChatClient::listGroups(std::uint16_t groupId, unsigned page) {
+    return queuePacket(ChatType::LIST_GROUPS, groupId,
+                       page > 1 ? std::to_string(page) : std::string());
+}
+
+bool AsyncChatClient::search(std::uint16_t groupId, const std::string& query) {
+    return queuePacket(ChatType::SEARCH, groupId, query);
+}
+
+std::size_t AsyncChatClient::pendingSendBytes() const {
+    std::lock_guard<std::mutex> lock(outMutex_);
+    return outBuf_.size();
+}
+
+bool AsyncChatClient::queuePacket(std::uint8_t type, std::uint16_t groupId,
+                                  const std::string& text) {
+    if (!running_) return false;
+
+    ChatPacket pkt{};
+    pkt.type      = type;
+    pkt.groupID   = htons(groupId);
+    pkt.timestamp = htonl(current_timestamp());
+    std::snprintf(pkt.payload, sizeof(pkt.payload), "%s", text.c_str());
+
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(outMutex_);
+        wasEmpty = outBuf_.empty();
+        outBuf_.append(reinterpret_cast<const char*>(&pkt), sizeof(pkt));
+    }
+    // the I/O thread is already draining a non-empty buffer
+    if (wasEmpty) wake();
+    return true;
+}
+
+void AsyncChatClient::wake() {
+    if (wakeFds_[1] < 0) return;
+    char b = 1;
+    ssize_t r = ::write(wakeFds_[1], &b, 1);
+    (void)r;   // pipe full just means a wakeup is already pending
+}
+
+bool AsyncChatClient::flushOutbound() {
+    if (shm_) return flushShm();
+
+    std::lock_guard<std::mutex> lock(outMutex_);
+    std::size_t off = 0;
+    while (off < outBuf_.size()) {
+        ssize_t n = ::send(sock_, outBuf_.data() + off, outBuf_.size() - off, kSendFlags);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return false;
+        }
+        off += static_cast<std::size_t>(n);
+    }
+    outBuf_.erase(0, off);
+    return true;
+}
+
+bool AsyncChatClient::readInbound(std::string& inBuf) {
+    char chunk[kReadChunk];
+    ssize_t n = ::recv(sock_, chunk, sizeof(chunk), 0);
+    if (n == 0) return false;
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    inBuf.append(chunk, static_cast<std::size_t>(n));
+
+    // decode every complete packet in one pass; a callback may close() us
+    std::size_t off = 0;
+    while (running_ && inBuf.size() - off >= sizeof(ChatPacket)) {
+        ChatPacket pkt;
+        std::memcpy(&pkt, inBuf.data() + off, sizeof(pkt));
+        off += sizeof(pkt);
+        dispatch(pkt);
+    }
+    inBuf.erase(0, off);
+    return running_.load();
+}
+
+// Shared-memory mode: the socket only carries wake bytes (or EOF).
+bool AsyncChatClient::readShm() {
+    char drain[64];
+    ssize_t n = ::recv(sock_, drain, sizeof(drain), 0);
+    if (n == 0) return false;
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return false;
+
+    // stop at a close() from a callback
+    ChatPacket pkt;
+    while (running_ && shm_ring_pop(shm_->toClient, pkt)) dispatch(pkt);
+    return running_.load();
+}
+
+bool AsyncChatClient::flushShm() {
+    std::lock_guard<std::mutex> lock(outMutex_);
+    std::size_t off = 0;
+    while (outBuf_.size() - off >= sizeof(ChatPacket)) {
+        ChatPacket pkt;
+        std::memcpy(&pkt, outBuf_.data() + off, sizeof(pkt));
+        if (!shm_ring_push(shm_->toServer, pkt)) break;   // full; retry next round
+        off += sizeof(pkt);
+    }
+    if (off > 0) shm_ring_wake(shm_->toServer, sock_);
+    outBuf_.erase(0, off);
+    return true;
+}
+
+void AsyncChatClient::dispatch(ChatPacket& pkt) {
+    // answer server pings here so callers never have to
+    if (pkt.type == ChatType::HEARTBEAT) {
+        queuePacket(ChatType::HEARTBEAT, 0, "");
+        return;
+    }
+
+    pkt.payload[sizeof(pkt.payload) - 1] = '\0';
+    if (onEvent_) {
+        onEvent_(ChatEvent{pkt.type, ntohs(pkt.groupID),
+                           ntohl(pkt.timestamp), pkt.payload});
+    }
+}
+
+void AsyncChatClient::ioLoop() {
+    std::string inBuf;
+    bool alive = true;
+
+    while (running_ && alive) {
+        pollfd pfds[2];
+        pfds[0] = pollfd{sock_, POLLIN, 0};
+        pfds[1] = pollfd{wakeFds_[0], POLLIN, 0};
+
+        int timeoutMs = -1;
+        if (!shm_) {
+            if (pendingSendBytes() > 0) pfds[0].events |= POLLOUT;
+        } else {
+            // a full ring has no fd to wait on, so retry stalled sends shortly
+            if (pendingSendBytes() > 0) timeoutMs = 1;
+            if (!shm_ring_prepare_sleep(shm_->toClient)) timeoutMs = 0;
+        }
+
+        int ready = ::poll(pfds, 2, timeoutMs);
+        if (shm_) shm_->toClient.sleeping.store(0);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (pfds[1].revents & POLLIN) {
+            char drain[64];
+            while (::read(wakeFds_[0], drain, sizeof(drain)) > 0) {}
+        }
+
+        if (shm_) {
+            alive = readShm();
+        } else if (pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            alive = readInbound(inBuf);
+        }
+        if (alive) {
+            alive = flushOutbound();
+        }
+    }
+
+    if (closeInLoop_) {
+        flushOutbound();   // best effort: whatever the kernel takes right now
+        releaseConnection();
+        return;
+    }
+
+    // only report a disconnect the caller didn't ask for
+    if (running_.exchange(false) && onDisconnect_) {
+        onDisconnect_();
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../Shared/protocol.h"
+
+struct ShmSegment;
+
+// A decoded server -> client packet (fields already in host order).
+struct ChatEvent {
+    std::uint8_t  type;        // ChatType::*
+    std::uint16_t groupId;
+    std::uint32_t timestamp;
+    std::string   text;
+};
+
+// Non-blocking chat client for bots, bridges and the CLI front-end.
+//
+// All send calls only encode a packet into an outbound buffer and return
+// immediately; a single I/O thread writes queued packets back-to-back
+// (pipelined, many per send()) and reads with one large recv() per wakeup,
+// decoding every complete packet it contains before invoking the callbacks.
+//
+// connectShm() is the same-host fast path: packets travel through a pair of
+// shared-memory rings (Shared/shm_ring.h) and the Unix socket only carries
+// wakeups, so a busy connection needs no syscalls per packet.
+//
+// Callbacks run on the I/O thread and must not block for long. They may call
+// close(), but must not destroy the client.
+class AsyncChatClient {
+public:
+    using EventHandler      = std::function<void(const ChatEvent&)>;
+    using DisconnectHandler = std::function<void()>;
+
+    AsyncChatClient();
+    ~AsyncChatClient();   // never from a callback
+
+    AsyncChatClient(const AsyncChatClient&) = delete;
+    AsyncChatClient& operator=(const AsyncChatClient&) = delete;
+
+    // set before connect()
+    void onEvent(EventHandler handler)           { onEvent_ = std::move(handler); }
+    void onDisconnect(DisconnectHandler handler) { onDisconnect_ = std::move(handler); }
+
+    // connect TCP socket and start the I/O thread
+    bool connect(const std::string& host, int port);
+
+    // same, over a server's --unix socket
+    bool connectUnix(const std::string& path);
+
+    // Unix socket plus a shared-memory segment for the packets themselves
+    bool connectShm(const std::string& path);
+
+    // flush queued packets (up to timeoutMs), then close the connection.
+    // From a callback it only stops the I/O thread, which makes one last
+    // flush and closes the connection once the callback has returned.
+    void close(int timeoutMs = 1000);
+
+    bool connected() const { return running_.load(); }
+
+    // queue packets; false if the connection is already closed
+    bool join(std::uint16_t groupId, const std::string& username);
+    bool leave(std::uint16_t groupId);
+    bool sendMessage(std::uint16_t groupId, const std::string& text);
+    bool listGroups(std::uint16_t groupId, unsigned page = 1);   // 1-based
+    // matches arrive as SEARCH events, newest first, then a SYSTEM summary
+    bool search(std::uint16_t groupId, const std::string& query);
+
+    std::size_t pendingSendBytes() const;
+
+private:
+    int sock_;
+    int wakeFds_[2];            // self-pipe used to wake the I/O thread
+    ShmSegment* shm_;           // non-null in shared-memory mode
+    std::atomic<bool> running_;
+    std::thread ioThread_;
+    bool closeInLoop_;          // I/O thread only: close() came from a callback
+
+    mutable std::mutex outMutex_;
+    std::string outBuf_;        // encoded packets not yet handed to the kernel
+
+    EventHandler      onEvent_;
+    DisconnectHandler onDisconnect_;
+
+    bool openUnixSocket(const std::string& path);
+    bool startIo();
+    void releaseConnection();   // close the fds and unmap shm; I/O thread stopped
+    bool attachShm();
+    bool queuePacket(std::uint8_t type, std::uint16_t groupId, const std::string& text);
+    void wake();
+    void ioLoop();
+    bool flushOutbound();       // false on a fatal socket error
+    bool readInbound(std::string& inBuf);
+    bool readShm();
+    bool flushShm();
+    void dispatch(ChatPacket& pkt);
+};
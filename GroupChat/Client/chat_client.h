@@ -3,6 +3,10 @@
 #include <string>
 #include <cstdint>   // for std::uint16_t
 
+#include "async_client.h"
+
+// Interactive CLI front-end: reads commands from stdin and prints incoming
+// packets. All networking lives in AsyncChatClient.
 class ChatClient {
 public:
     ChatClient(const std::string& host, int port);
@@ -16,15 +20,9 @@ public:
 private:
     std::string  host_;
     int          port_;
-    int          sock_;
     std::string  username_;
     std::uint16_t currentGroup_;   // <-- this is the group ID
-    bool         running_;
-
-    void receiverLoop();
+    AsyncChatClient conn_;
 
-    bool sendJoin(std::uint16_t groupId);
-    bool sendLeave(std::uint16_t groupId);
-    bool sendMessage(const std::string& text);
-    bool sendListGroups();
+    void printEvent(const ChatEvent& ev);
 };
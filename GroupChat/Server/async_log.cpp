@@ -0,0 +1,156 @@
+// Server/async_log.cpp
+#include "async_log.h"
+#include "../Shared/thread_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::system_clock;
+
+namespace {
+
+constexpr std::size_t kRingSize   = 64;     // records per thread (~13 KiB)
+constexpr std::size_t kMessageLen = 192;
+
+struct LogRecord {
+    std::int64_t  timeUs;
+    LogLevel      level;
+    std::uint32_t threadId;
+    char          msg[kMessageLen];
+};
+
+// one ring per logging thread, drained by the drain thread
+ThreadRingSet<LogRecord, kRingSize> g_rings;
+
+std::atomic<bool>          g_running{false};
+std::atomic<std::uint64_t> g_dropped{0};
+std::atomic<std::uint8_t>  g_minLevel{static_cast<std::uint8_t>(LogLevel::Info)};
+std::FILE*                 g_file = nullptr;
+bool                       g_echo = true;
+std::thread                g_drainThread;
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info:  return "INFO ";
+        case LogLevel::Warn:  return "WARN ";
+        case LogLevel::Error: return "ERROR";
+    }
+    return "?    ";
+}
+
+std::int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+void writeRecord(std::FILE* out, const LogRecord& rec) {
+    std::time_t secs = static_cast<std::time_t>(rec.timeUs / 1000000);
+    std::tm tm{};
+    localtime_r(&secs, &tm);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    std::fprintf(out, "%s.%06lld %s [t%u] %s\n", stamp,
+                 static_cast<long long>(rec.timeUs % 1000000),
+                 levelName(rec.level), rec.threadId, rec.msg);
+}
+
+// Moves everything currently queued out of the rings.
+void collect(std::vector<LogRecord>& batch) {
+    g_rings.drain([&batch](const LogRecord& rec) { batch.push_back(rec); });
+}
+
+void flushBatch(std::vector<LogRecord>& batch) {
+    if (batch.empty()) return;
+    std::stable_sort(batch.begin(), batch.end(),
+                     [](const LogRecord& a, const LogRecord& b) {
+                         return a.timeUs < b.timeUs;
+                     });
+    for (const auto& rec : batch) {
+        if (g_file) writeRecord(g_file, rec);
+        if (g_echo) writeRecord(stdout, rec);
+    }
+    if (g_file) std::fflush(g_file);
+    if (g_echo) std::fflush(stdout);
+    batch.clear();
+}
+
+void drainLoop() {
+    std::vector<LogRecord> batch;
+    batch.reserve(256);
+    while (g_running.load()) {
+        collect(batch);
+        flushBatch(batch);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    collect(batch);   // final pass after shutdown was requested
+    flushBatch(batch);
+}
+
+} // namespace
+
+void log_init(const std::string& path, LogLevel minLevel, bool echoToStdout) {
+    if (g_running.load()) return;
+
+    g_file = std::fopen(path.c_str(), "a");
+    if (!g_file) {
+        std::fprintf(stderr, "log_init: cannot open %s, logging to stdout only\n",
+                     path.c_str());
+    }
+    g_echo = echoToStdout;
+    g_minLevel.store(static_cast<std::uint8_t>(minLevel));
+    g_running.store(true);
+    g_drainThread = std::thread(drainLoop);
+}
+
+void log_shutdown() {
+    if (!g_running.exchange(false)) return;
+    if (g_drainThread.joinable()) g_drainThread.join();
+    if (g_file) {
+        std::fclose(g_file);
+        g_file = nullptr;
+    }
+}
+
+void log_write(LogLevel level, const char* fmt, ...) {
+    if (static_cast<std::uint8_t>(level) < g_minLevel.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    if (!g_running.load(std::memory_order_acquire)) {
+        std::fprintf(stderr, "%s ", levelName(level));
+        va_list args;
+        va_start(args, fmt);
+        std::vfprintf(stderr, fmt, args);
+        va_end(args);
+        std::fputc('\n', stderr);
+        return;
+    }
+
+    auto& ring = g_rings.local();
+    LogRecord* rec = ring.claim();
+    if (!rec) {
+        g_dropped++;
+        return;
+    }
+
+    rec->timeUs   = nowUs();
+    rec->level    = level;
+    rec->threadId = ring.threadId;
+    va_list args;
+    va_start(args, fmt);
+    std::vsnprintf(rec->msg, sizeof(rec->msg), fmt, args);
+    va_end(args);
+
+    ring.publish();
+}
+
+std::uint64_t log_dropped() {
+    return g_dropped.load();
+}
@@ -0,0 +1,32 @@
+// Server/async_log.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Asynchronous logger.
+//
+// Each thread writes fixed-size records into its own single-producer ring
+// buffer (no locks, no syscalls on the calling thread). A background thread
+// drains all rings, orders each batch by timestamp and writes it to the log
+// file (and optionally stdout). When a ring is full the record is dropped
+// and counted rather than blocking the caller.
+//
+// Before log_init() (or after log_shutdown()) messages go straight to stderr.
+
+enum class LogLevel : std::uint8_t { Debug = 0, Info, Warn, Error };
+
+void log_init(const std::string& path,
+              LogLevel minLevel = LogLevel::Info,
+              bool echoToStdout = true);
+void log_shutdown();                 // drain everything, flush and stop
+
+void log_write(LogLevel level, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+std::uint64_t log_dropped();         // records lost to full rings
+
+#define log_debug(...) log_write(LogLevel::Debug, __VA_ARGS__)
+#define log_info(...)  log_write(LogLevel::Info,  __VA_ARGS__)
+#define log_warn(...)  log_write(LogLevel::Warn,  __VA_ARGS__)
+#define log_error(...) log_write(LogLevel::Error, __VA_ARGS__)
@@ -0,0 +1,85 @@
+// Server/buffer_pool.cpp
+#include "buffer_pool.h"
+
+#include <new>
+
+BufferPool::BufferPool(const char* name) : name_(name) {}
+
+BufferPool::~BufferPool() {
+    for (auto& sc : classes_) {
+        for (void* slab : sc.slabs) ::operator delete(slab);
+    }
+}
+
+std::size_t BufferPool::classIndex(std::size_t bytes) {
+    std::size_t idx = 0;
+    while (idx < kClasses && classSize(idx) < bytes) ++idx;
+    return idx;
+}
+
+void* BufferPool::allocate(std::size_t bytes) {
+    allocs_++;
+    std::size_t idx = classIndex(bytes);
+    if (idx == kClasses) {
+        oversize_++;
+        return ::operator new(bytes);
+    }
+
+    SizeClass& sc = classes_[idx];
+    std::lock_guard<std::mutex> lock(sc.mtx);
+    if (!sc.freeList) {
+        // carve a fresh slab into blocks and thread them onto the free list
+        std::size_t blockSize = classSize(idx);
+        char* slab = static_cast<char*>(::operator new(blockSize * kBlocksPerSlab));
+        sc.slabs.push_back(slab);
+        for (std::size_t i = 0; i < kBlocksPerSlab; ++i) {
+            auto* b = reinterpret_cast<FreeBlock*>(slab + i * blockSize);
+            b->next = sc.freeList;
+            sc.freeList = b;
+        }
+        slabRefills_++;
+        bytesReserved_ += blockSize * kBlocksPerSlab;
+    }
+
+    FreeBlock* b = sc.freeList;
+    sc.freeList = b->next;
+    return b;
+}
+
+void BufferPool::deallocate(void* p, std::size_t bytes) {
+    if (!p) return;
+    frees_++;
+    std::size_t idx = classIndex(bytes);
+    if (idx == kClasses) {
+        ::operator delete(p);
+        return;
+    }
+
+    SizeClass& sc = classes_[idx];
+    std::lock_guard<std::mutex> lock(sc.mtx);
+    auto* b = static_cast<FreeBlock*>(p);
+    b->next = sc.freeList;
+    sc.freeList = b;
+}
+
+void BufferPool::dump(std::ostream& os) const {
+    std::uint64_t a = allocs_.load();
+    std::uint64_t f = frees_.load();
+    os << name_ << " pool: allocs=" << a
+       << "  frees=" << f
+       << "  in use=" << (a - f)
+       << "  slab refills=" << slabRefills_.load()
+       << "  oversize=" << oversize_.load()
+       << "  reserved=" << bytesReserved_.load() << " bytes\n";
+}
+
+// never destroyed: detached client threads may still free into them at exit
+BufferPool& message_pool() {
+    static BufferPool* pool = new BufferPool("Message");
+    return *pool;
+}
+
+BufferPool& session_pool() {
+    static BufferPool* pool = new BufferPool("Session");
+    return *pool;
+}
@@ -0,0 +1,86 @@
+// Server/buffer_pool.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Size-classed pool allocator.
+//
+// Requests are rounded up to a power-of-two class (64 B .. 4 KiB). Each
+// class keeps an intrusive free list refilled one slab (kBlocksPerSlab
+// blocks) at a time, and freed blocks go back on the list instead of to the
+// heap, so once the working set is warm allocate/deallocate never call
+// malloc. Larger requests fall back to operator new and are counted.
+class BufferPool {
+public:
+    explicit BufferPool(const char* name);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    void* allocate(std::size_t bytes);
+    void  deallocate(void* p, std::size_t bytes);
+
+    void dump(std::ostream& os) const;
+
+private:
+    static constexpr std::size_t kMinShift      = 6;    // 64 B
+    static constexpr std::size_t kClasses       = 7;    // .. 4 KiB
+    static constexpr std::size_t kBlocksPerSlab = 64;
+
+    struct FreeBlock { FreeBlock* next; };
+
+    struct SizeClass {
+        std::mutex mtx;
+        FreeBlock* freeList = nullptr;
+        std::vector<void*> slabs;
+    };
+
+    const char* name_;
+    std::array<SizeClass, kClasses> classes_;
+
+    std::atomic<std::uint64_t> allocs_{0};
+    std::atomic<std::uint64_t> frees_{0};
+    std::atomic<std::uint64_t> slabRefills_{0};   // heap allocations made by the pool
+    std::atomic<std::uint64_t> oversize_{0};      // requests too big for any class
+    std::atomic<std::uint64_t> bytesReserved_{0};
+
+    static std::size_t classIndex(std::size_t bytes);   // kClasses if oversize
+    static std::size_t classSize(std::size_t idx) { return std::size_t(1) << (kMinShift + idx); }
+};
+
+// Pool for in-flight broadcast messages.
+BufferPool& message_pool();
+
+// Pool for per-connection session state.
+BufferPool& session_pool();
+
+// std-compatible allocator over a BufferPool (for allocate_shared etc.).
+template <typename T>
+struct PoolAllocator {
+    using value_type = T;
+
+    BufferPool* pool;
+
+    explicit PoolAllocator(BufferPool& p) : pool(&p) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(pool->allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, std::size_t n) {
+        pool->deallocate(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& o) const { return pool == o.pool; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& o) const { return pool != o.pool; }
+};
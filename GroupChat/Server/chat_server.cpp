@@ -3,53 +3,172 @@
 #include "../Shared/protocol.h"
 #include "../Shared/utils.h"
 #include "perf_stats.h"
+#include "traffic_capture.h"
+#include "buffer_pool.h"
+#include "async_log.h"
+#include "transport.h"
+#include "msg_trace.h"
 
 #include <iostream>
 #include <thread>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/un.h>
+#include <fcntl.h>
 #include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
 #include <csignal>
 #include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <vector>
 
 // -------- global run flag + signal handler for Ctrl+C --------
 
 static std::atomic<bool> g_running{true};
+static int g_shutdownPipe[2] = {-1, -1};   // written by handle_sigint, polled by run()
 
+// Only async-signal-safe work here: the accept loop wakes on the pipe and
+// does the logging and stats dump on an ordinary thread.
 void handle_sigint(int)
 {
-    // stop the accept loop
+    int savedErrno = errno;
     g_running.store(false);
+    char b = 1;
+    if (write(g_shutdownPipe[1], &b, 1) < 0) {
+        // pipe full: a wakeup is already pending
+    }
+    errno = savedErrno;
+}
 
-    std::cerr << "\nSIGINT received, dumping stats...\n";
-    stats_dump_to_stdout();
-    stats_dump_to_file("logs/performance.txt");
+// -------- per-connection session state --------
+
+static std::int64_t now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Shared between the connection's handler thread, its idle timer and any
+// queued Control-lane replies, and allocated (control block included) from
+// session_pool(). The descriptor is only closed when the last reference
+// goes away, so a late reply can never land on a recycled fd; `closed`
+// (under mtx) marks the connection as finished before that.
+struct ConnSession {
+    int sock;
+    // written only by the connection thread, under mtx; other threads
+    // (queued replies) read them under mtx
+    char username[sizeof(ChatPacket::payload)] = "anonymous";
+    uint16_t currentGroup = 1;
+    std::atomic<std::int64_t> lastActivityMs;
+    std::mutex mtx;
+    std::atomic<bool> closed{false};
+    std::int64_t pingSentMs = 0;     // 0 = no unanswered ping
+    TimerWheel::TimerId timer = 0;
+    std::uint32_t peerNode = 0;      // set by NODE_HELLO on inter-node links
+    bool isPeer = false;
+
+    // this connection's MESSAGE fan-outs queued or running, and the Control
+    // replies held back until they finish (under mtx)
+    std::atomic<std::uint32_t> pendingBulk{0};
+    std::vector<std::function<void()>> deferredReplies;
+
+    explicit ConnSession(int s) : sock(s), lastActivityMs(now_ms()) {}
+    ~ConnSession() {
+        transport_detach(sock);
+        close(sock);
+    }
+};
+
+// A MESSAGE waiting in the ThreadPool queue. Lives in message_pool() and is
+// passed to the task by pointer; everything the task needs is in here, so
+// the lambda is {this, msg} and fits std::function's inline storage.
+struct InFlightMessage {
+    uint16_t      groupId;
+    bool          owner;        // stamp and fan out to subscribed nodes
+    ChatPacket    pkt;
+    std::uint32_t traceId;      // 0 = not sampled
+    std::uint64_t enqueuedUs;   // only set when traced
+    std::shared_ptr<ConnSession> sender;   // null for messages from other nodes
+};
+
+// -------- LIST_GROUPS formatting --------
 
-    std::_Exit(0);   // exit immediately after dumping stats
+// ~19 bytes per entry worst case, so a page always fits one payload
+static constexpr std::size_t kGroupsPerPage = 10;
+
+// SEARCH replies: at most this many matching messages, newest first
+static constexpr std::size_t kSearchResults = 20;
+
+// "Groups p1/2 v42: 7:3u/5s 9:1u/120s ..." -- id:members/seconds since last activity
+static void formatGroupPage(const GroupDirectory& dir, std::size_t page,
+                            char* out, std::size_t len) {
+    std::size_t total = dir.groups.size();
+    std::size_t pages = total ? (total + kGroupsPerPage - 1) / kGroupsPerPage : 1;
+    if (page >= pages) page = pages - 1;
+
+    int n = std::snprintf(out, len, "Groups p%zu/%zu v%llu:", page + 1, pages,
+                          static_cast<unsigned long long>(dir.version));
+    if (total == 0) {
+        std::snprintf(out + n, len - n, " (none)");
+        return;
+    }
+
+    uint32_t now = current_timestamp();
+    std::size_t end = std::min(total, (page + 1) * kGroupsPerPage);
+    for (std::size_t i = page * kGroupsPerPage; i < end && static_cast<std::size_t>(n) < len; ++i) {
+        const auto& g = dir.groups[i];
+        uint32_t last = g.activity->lastActivity.load(std::memory_order_relaxed);
+        n += std::snprintf(out + n, len - n, " %u:%uu/%us", g.groupId, g.members,
+                           now > last ? now - last : 0);
+    }
 }
 
 // -------- ChatServer implementation --------
 
-ChatServer::ChatServer(int port, std::size_t workerThreads)
-    : port_(port), server_fd_(-1), groups_(50), pool_(workerThreads) {}
+ChatServer::ChatServer(int port, const PoolSizing& workers,
+                       const AdmissionConfig& admission,
+                       const LivenessConfig& liveness,
+                       const AffinityConfig& affinity,
+                       unsigned controlWeight)
+    : port_(port), server_fd_(-1), unix_fd_(-1), groups_(50),
+      pool_(workers, controlWeight, affinity.workerCpus),
+      admission_(admission),
+      groupLimiter_(admission.groupRate, admission.groupBurst),
+      inFlight_(0),
+      liveness_(liveness),
+      ioCpus_(affinity.ioCpus),
+      nextConnId_(1),
+      upgrade_fd_(-1),
+      handingOff_(false),
+      parked_(0),
+      starting_(0) {
+    // no group exists yet, so every cache will be allocated the same way
+    numa_set_placement(!affinity.workerCpus.empty() || !affinity.ioCpus.empty());
+}
 
 ChatServer::~ChatServer() {
     if (server_fd_ >= 0) close(server_fd_);
+    if (upgrade_fd_ >= 0) {
+        close(upgrade_fd_);
+        unlink(upgradePath_.c_str());
+    }
+    if (unix_fd_ >= 0) {
+        close(unix_fd_);
+        unlink(unixPath_.c_str());
+    }
 }
 
-void ChatServer::run() {
-    // init performance stats
-    stats_init();
-    stats_init_vm(32);
-
-    // install Ctrl+C handler (SIGINT)
-    std::signal(SIGINT, handle_sigint);
-
+bool ChatServer::openTcpListener() {
     server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd_ < 0) {
-        perror("socket");
-        return;
+        log_error("socket: %s", std::strerror(errno));
+        return false;
     }
 
     int opt = 1;
@@ -61,95 +180,738 @@ void ChatServer::run() {
     addr.sin_port = htons(port_);
 
     if (bind(server_fd_, (sockaddr*)&addr, sizeof(addr)) < 0) {
-        perror("bind");
-        return;
+        log_error("bind: %s", std::strerror(errno));
+        return false;
     }
 
     if (listen(server_fd_, 16) < 0) {
-        perror("listen");
+        log_error("listen: %s", std::strerror(errno));
+        return false;
+    }
+
+    log_info("Chat server listening on port %d...", port_);
+    return true;
+}
+
+bool ChatServer::openUnixListener() {
+    sockaddr_un addr{};
+    if (unixPath_.size() >= sizeof(addr.sun_path)) {
+        log_error("unix socket path too long: %s", unixPath_.c_str());
+        return false;
+    }
+
+    unix_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (unix_fd_ < 0) {
+        log_error("unix socket: %s", std::strerror(errno));
+        return false;
+    }
+
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, unixPath_.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(unixPath_.c_str());   // stale socket file from a previous run
+
+    if (bind(unix_fd_, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(unix_fd_, 16) < 0) {
+        log_error("unix bind/listen %s: %s", unixPath_.c_str(), std::strerror(errno));
+        close(unix_fd_);
+        unix_fd_ = -1;
+        return false;
+    }
+
+    log_info("Chat server listening on unix socket %s", unixPath_.c_str());
+    return true;
+}
+
+void ChatServer::run() {
+    // init performance stats
+    stats_init();
+    stats_init_vm(32);
+
+    // install Ctrl+C handler (SIGINT)
+    if (pipe2(g_shutdownPipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        log_error("pipe: %s", std::strerror(errno));
         return;
     }
+    std::signal(SIGINT, handle_sigint);
+
+    // a send to a peer that already went away must fail, not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
 
-    std::cout << "Chat server listening on port " << port_ << "...\n";
+    // kill -USR2: write the sampled message trace (restartable, unlike SIGUSR1)
+    std::signal(SIGUSR2, [](int) { trace_request_export(); });
+    // kill -HUP: change the trace sampling rate to the number in logs/trace.rate
+    std::signal(SIGHUP, [](int) { trace_request_rate_reload(); });
+
+    // used to knock connection threads out of recv() for a hot upgrade;
+    // no SA_RESTART, so the blocked call returns EINTR
+    struct sigaction sa{};
+    sa.sa_handler = [](int) {};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, nullptr);
+
+    bool adopted = !upgradePath_.empty() && takeOver();
+    if (!adopted) {
+        if (!openTcpListener()) return;
+        if (!unixPath_.empty() && !openUnixListener()) return;
+    }
+
+    if (!upgradePath_.empty()) {
+        upgrade_fd_ = upgrade_listen(upgradePath_);
+        if (upgrade_fd_ < 0) {
+            log_warn("hot upgrade socket %s: %s", upgradePath_.c_str(), std::strerror(errno));
+        }
+    }
+
+    // tcp, unix, upgrade, shutdown -- absent ones have fd -1, which poll() ignores
+    pollfd listeners[4] = {{server_fd_, POLLIN, 0}, {unix_fd_, POLLIN, 0},
+                           {upgrade_fd_, POLLIN, 0}, {g_shutdownPipe[0], POLLIN, 0}};
 
     while (g_running.load()) {
-        sockaddr_in clientAddr{};
-        socklen_t len = sizeof(clientAddr);
-        int clientSock = accept(server_fd_, (sockaddr*)&clientAddr, &len);
-        if (clientSock < 0) {
+        if (poll(listeners, 4, -1) < 0) {
             if (!g_running.load()) break;   // shutting down; stop cleanly
-            perror("accept");
+            if (errno != EINTR) log_error("poll: %s", std::strerror(errno));
             continue;
         }
 
-        std::thread(&ChatServer::handleClient, this, clientSock).detach();
+        if (listeners[2].revents & POLLIN) {
+            int ctl = accept(upgrade_fd_, nullptr, nullptr);
+            if (ctl >= 0) handOff(ctl);   // only returns if the handoff failed
+        }
+
+        for (nfds_t i = 0; i < 2; ++i) {
+            if (!(listeners[i].revents & POLLIN)) continue;
+
+            int clientSock = accept(listeners[i].fd, nullptr, nullptr);
+            if (clientSock < 0) {
+                if (!g_running.load()) break;
+                log_error("accept: %s", std::strerror(errno));
+                continue;
+            }
+
+            std::uint32_t connId = nextConnId_++;
+            log_info("Connection %u accepted (%s)", connId, i == 0 ? "tcp" : "unix");
+            {
+                std::lock_guard<std::mutex> lock(connsMtx_);
+                ++starting_;   // until handleClient registers it in conns_
+            }
+            std::thread(&ChatServer::handleClient, this, clientSock, connId, nullptr).detach();
+        }
     }
 
-    // if we ever exit the loop normally, also dump stats here
+    log_info("Shutting down, dumping stats...");
     stats_dump_to_stdout();
     stats_dump_to_file("logs/performance.txt");
+    capture_close();
+    log_shutdown();
 }
 
-void ChatServer::handleClient(int clientSock) {
-    std::string username = "anonymous";
-    uint16_t currentGroup = 1;
+// a ping that couldn't be written right away is retried this often
+static constexpr std::int64_t kPingRetryMs = 100;
 
-    while (true) {
-        ChatPacket pkt{};
-        if (!recv_all(clientSock, &pkt, sizeof(ChatPacket))) {
-            std::cout << "Client disconnected.\n";
-            groups_.leaveGroup(currentGroup, clientSock);
-            close(clientSock);
-            return;
-        }
+// Runs on the timer wheel thread: ping a quiet connection, reap a dead one,
+// otherwise re-arm for the next deadline. One timer per connection, so the
+// receive path only has to touch lastActivityMs.
+void ChatServer::checkLiveness(const std::shared_ptr<ConnSession>& conn) {
+    std::lock_guard<std::mutex> lock(conn->mtx);
+    if (conn->closed) return;
 
-        // convert fields from network order
-        uint16_t groupId = ntohs(pkt.groupID);
-        uint32_t ts      = ntohl(pkt.timestamp);
-        (void)ts; // currently unused
+    // mid-handoff the socket may already belong to the new process: neither
+    // ping nor reap it, just look again later. handOff takes conn->mtx once
+    // after setting handingOff_, so no check that missed the flag is left.
+    if (handingOff_.load()) {
+        std::shared_ptr<ConnSession> self = conn;
+        conn->timer = timers_.schedule(std::chrono::milliseconds(liveness_.heartbeatMs),
+                                       [this, self] { checkLiveness(self); });
+        return;
+    }
 
-        switch (pkt.type) {
-            case ChatType::JOIN: {
-                username = std::string(pkt.payload);
-                currentGroup = groupId;
-                groups_.joinGroup(groupId, ClientInfo{clientSock, username});
-                groups_.sendRecentMessages(groupId, clientSock);
-                break;
+    std::int64_t now  = now_ms();
+    std::int64_t last = conn->lastActivityMs.load();
+    std::int64_t idle = now - last;
+    if (last >= conn->pingSentMs) conn->pingSentMs = 0;   // ping was answered
+
+    if (idle >= liveness_.idleTimeoutMs) {
+        log_warn("Reaping connection on socket %d (idle %lld ms)",
+                 conn->sock, static_cast<long long>(idle));
+        // wakes the handler thread out of recv_all; it does the cleanup
+        shutdown(conn->sock, SHUT_RDWR);
+        stats_record_reaped();
+        return;
+    }
+
+    std::int64_t next;
+    if (idle >= liveness_.heartbeatMs) {
+        next = liveness_.idleTimeoutMs - idle;
+        if (conn->pingSentMs == 0) {
+            ChatPacket ping{};
+            ping.type      = ChatType::HEARTBEAT;
+            ping.timestamp = htonl(current_timestamp());
+            // never block the wheel on a peer that isn't reading; a partial
+            // write would desync the stream, so treat it as dead
+            TrySend r = transport_try_send(conn->sock, ping);
+            if (r == TrySend::Failed) {
+                shutdown(conn->sock, SHUT_RDWR);
+                stats_record_reaped();
+                return;
             }
-            case ChatType::MESSAGE: {
-                // track stats
-                stats_record_message();
-                stats_vm_access(groupId);
-
-                // broadcast via thread pool
-                pool_.enqueue([this, pkt, groupId]() {
-                    ChatPacket toSend = pkt;
-                    // timestamp on server
-                    toSend.timestamp = htonl(current_timestamp());
-                    groups_.broadcastToGroup(groupId, toSend);
-                });
-                break;
+            if (r == TrySend::Sent) {
+                conn->pingSentMs = now;
+                stats_record_heartbeat_sent();
+            } else {
+                // buffer full or a broadcast mid-write: try again shortly
+                next = std::min<std::int64_t>(next, kPingRetryMs);
             }
-            case ChatType::LEAVE: {
-                groups_.leaveGroup(groupId, clientSock);
-                close(clientSock);
-                return;
+        }
+    } else {
+        next = liveness_.heartbeatMs - idle;
+    }
+
+    std::shared_ptr<ConnSession> self = conn;
+    conn->timer = timers_.schedule(std::chrono::milliseconds(next),
+                                   [this, self] { checkLiveness(self); });
+}
+
+// -------- hot upgrade --------
+
+// New process: adopt the listeners, connections and history of the server
+// on upgradePath_. False (cold start) if there is none or it refused.
+bool ChatServer::takeOver() {
+    UpgradeState st;
+    int ctl = upgrade_take_over(upgradePath_, st);
+    if (ctl < 0) return false;
+
+    server_fd_ = st.tcpListener;
+    unix_fd_   = st.unixListener;
+    if (unix_fd_ >= 0) unixPath_ = st.unixPath;
+    nextConnId_ = st.nextConnId;
+    for (const auto& kv : st.history) {
+        groups_.restoreHistory(kv.first, kv.second);
+        for (const ChatPacket& pkt : kv.second) search_.add(kv.first, pkt);
+    }
+
+    // from here on the old process is gone and the sockets are ours alone
+    upgrade_finish(ctl);
+
+    {
+        std::lock_guard<std::mutex> lock(connsMtx_);
+        starting_ += st.conns.size();
+    }
+    for (const UpgradeConn& c : st.conns) {
+        std::thread([this, c] { handleClient(c.fd, c.connId, &c); }).detach();
+    }
+    log_info("Hot upgrade: took over %zu connections and %zu group histories",
+             st.conns.size(), st.history.size());
+    return true;
+}
+
+// Old process: park every connection thread between reads, let queued
+// broadcasts finish, then hand everything to the new binary and exit.
+// Runs on the accept thread, so nothing new is accepted meanwhile; clients
+// still in the backlog go to the new process with the listener.
+void ChatServer::handOff(int ctl) {
+    using Clock = std::chrono::steady_clock;
+    if (!upgrade_read_request(ctl)) {
+        close(ctl);
+        return;
+    }
+
+    bool ready = true;
+    auto deadline = Clock::now() + std::chrono::seconds(2);
+    handingOff_ = true;
+    {
+        std::unique_lock<std::mutex> lock(connsMtx_);
+        log_info("Hot upgrade requested, parking %zu connections",
+                 conns_.size() + starting_);
+
+        // any liveness check that started before handingOff_ was set has
+        // finished once we hold its session lock; later ones leave it alone
+        for (auto& kv : conns_) {
+            std::lock_guard<std::mutex> sessionLock(kv.second.session->mtx);
+        }
+
+        // accepted connections whose thread hasn't registered yet count too
+        while (starting_ > 0 || parked_ < conns_.size()) {
+            // repeat: a thread may have been just about to enter recv()
+            for (auto& kv : conns_) pthread_kill(kv.second.thread, SIGUSR1);
+            handoffCv_.wait_for(lock, std::chrono::milliseconds(10));
+            if (Clock::now() >= deadline) {
+                ready = false;
+                break;
             }
-            case ChatType::LIST_GROUPS: {
-                auto ids = groups_.listGroups();
-                for (uint16_t id : ids) {
-                    ChatPacket resp{};
-                    resp.type = ChatType::SYSTEM;
-                    resp.groupID = htons(id);
-                    std::snprintf(resp.payload, sizeof(resp.payload),
-                                  "Active group: %u", id);
-                    resp.timestamp = htonl(current_timestamp());
-                    send_all(clientSock, &resp, sizeof(resp));
+        }
+    }
+    // nothing queued and nothing running: a reply half-written when we exit
+    // would corrupt the stream the new process continues
+    auto busy = [this](TaskLane lane) {
+        return pool_.queueSize(lane) > 0 || pool_.runningTasks(lane) > 0;
+    };
+    while (ready && (inFlight_.load() > 0 || busy(TaskLane::Control) || busy(TaskLane::Bulk))) {
+        if (Clock::now() >= deadline) ready = false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (ready) {
+        UpgradeState st;
+        st.tcpListener  = server_fd_;
+        st.unixListener = unix_fd_;
+        st.unixPath     = unixPath_;
+        st.nextConnId   = nextConnId_.load();
+        st.history      = groups_.history();
+
+        auto members = groups_.memberSockets();
+        std::lock_guard<std::mutex> lock(connsMtx_);
+        for (const auto& kv : conns_) {
+            ConnSession& s = *kv.second.session;
+            std::lock_guard<std::mutex> sessionLock(s.mtx);
+            // shm mappings and inter-node links don't survive; those peers reconnect
+            if (s.closed || s.isPeer || transport_is_shm(s.sock)) continue;
+            bool joined = std::find(members.begin(), members.end(),
+                                    std::make_pair(s.currentGroup, s.sock)) != members.end();
+            const RecvBuffer& b = *kv.second.buf;
+            st.conns.push_back(UpgradeConn{s.sock, kv.first, s.currentGroup, joined, s.username,
+                                           std::string(b.data.get() + b.begin, b.end - b.begin)});
+        }
+        ready = upgrade_send_state(ctl, st) && upgrade_wait_ready(ctl, 5000);
+        if (ready) {
+            log_info("Hot upgrade: handed over %zu connections, exiting", st.conns.size());
+            log_shutdown();
+            stats_dump_to_file("logs/performance.txt");
+            capture_close();
+            std::_Exit(0);   // our copies of the sockets close; the new process keeps its own
+        }
+    }
+
+    log_warn("Hot upgrade failed, resuming");
+    close(ctl);
+    handingOff_ = false;
+    std::lock_guard<std::mutex> lock(connsMtx_);
+    handoffCv_.notify_all();
+}
+
+void ChatServer::parkIfHandingOff() {
+    if (!handingOff_.load()) return;
+    std::unique_lock<std::mutex> lock(connsMtx_);
+    ++parked_;
+    handoffCv_.notify_all();
+    handoffCv_.wait(lock, [this] { return !handingOff_.load(); });
+    --parked_;
+}
+
+// Queues the Bulk fan-out of one MESSAGE to this node's members. The
+// group's owner (every group, when standalone) stamps it and copies it to
+// subscribed nodes inside the same critical section as the local send; a
+// NODE_FANOUT copy arrives already stamped and is not queued here at all.
+void ChatServer::enqueueBroadcast(uint16_t groupId, const ChatPacket& pkt, bool owner,
+                                  std::uint32_t traceId,
+                                  const std::shared_ptr<ConnSession>& sender) {
+    inFlight_++;
+    if (sender) sender->pendingBulk++;
+    void* mem = message_pool().allocate(sizeof(InFlightMessage));
+    std::uint64_t enqueuedUs = traceId ? trace_now_us() : 0;
+    auto* msg = new (mem) InFlightMessage{groupId, owner, pkt, traceId, enqueuedUs, sender};
+
+    pool_.enqueue([this, msg]() {
+        if (msg->traceId) {
+            trace_span(msg->traceId, TraceStage::QueueWait, msg->enqueuedUs,
+                       trace_now_us(), msg->groupId);
+        }
+        if (msg->owner) {
+            // stamp and forward under the group lock: the order workers take
+            // it in is the group's order on every node
+            groups_.broadcastToGroup(msg->groupId, msg->pkt, msg->traceId,
+                                     [this, msg](ChatPacket& pkt) {
+                // timestamp on server
+                pkt.timestamp = htonl(current_timestamp());
+                msg->pkt.timestamp = pkt.timestamp;
+                if (cluster_) cluster_->fanout(msg->groupId, pkt);
+            });
+        } else {
+            groups_.broadcastToGroup(msg->groupId, msg->pkt, msg->traceId);
+        }
+        search_.add(msg->groupId, msg->pkt);
+        std::shared_ptr<ConnSession> sender = std::move(msg->sender);
+        msg->~InFlightMessage();
+        message_pool().deallocate(msg, sizeof(InFlightMessage));
+        // before inFlight_ drops, so a drained pool never misses the replies
+        if (sender && sender->pendingBulk.fetch_sub(1) == 1) releaseReplies(*sender);
+        inFlight_--;
+    });
+
+    // msg may already be gone; only the locals are safe here
+    if (traceId) trace_span(traceId, TraceStage::Enqueue, enqueuedUs, trace_now_us(), groupId);
+}
+
+// Queues Control work that answers `session`. If the connection still has
+// MESSAGE fan-outs in flight the reply waits for them, so it never overtakes
+// the connection's own earlier messages (a SEARCH finds them, a history
+// replay after a rejoin includes them) whatever the lane weight.
+void ChatServer::enqueueReply(const std::shared_ptr<ConnSession>& session,
+                              std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(session->mtx);
+        if (session->pendingBulk.load() > 0) {
+            session->deferredReplies.push_back(std::move(task));
+            return;
+        }
+    }
+    pool_.enqueue(std::move(task), TaskLane::Control);
+}
+
+// Called by the fan-out task that took pendingBulk to zero.
+void ChatServer::releaseReplies(ConnSession& session) {
+    std::vector<std::function<void()>> replies;
+    {
+        std::lock_guard<std::mutex> lock(session.mtx);
+        // the connection thread may have queued another message meanwhile;
+        // its fan-out releases the replies instead
+        if (session.pendingBulk.load() > 0) return;
+        replies.swap(session.deferredReplies);
+    }
+    for (auto& task : replies) pool_.enqueue(std::move(task), TaskLane::Control);
+}
+
+// Subscribes to (or drops) a remote owner's traffic for a group as its
+// first local member joins or its last one leaves.
+void ChatServer::setLocalMembers(uint16_t groupId, bool present) {
+    if (cluster_) cluster_->setLocalMembers(groupId, present);
+}
+
+// handleClient's per-connection state, shared with the packet handlers
+struct ChatServer::ClientConn {
+    int sock;
+    std::uint32_t connId;
+    std::shared_ptr<ConnSession> session;
+    TokenBucket limiter;
+    std::uint64_t recvUs = 0;   // when the current batch was read; 0 unless tracing
+};
+
+// Built at compile time; unknown or server-only types fall through to onIgnore.
+constexpr std::array<ChatServer::PacketHandler, 256> ChatServer::makeHandlers() {
+    std::array<PacketHandler, 256> table{};
+    for (auto& h : table) h = &ChatServer::onIgnore;
+    table[ChatType::JOIN]             = &ChatServer::onJoin;
+    table[ChatType::MESSAGE]          = &ChatServer::onMessage;
+    table[ChatType::LEAVE]            = &ChatServer::onLeave;
+    table[ChatType::LIST_GROUPS]      = &ChatServer::onListGroups;
+    table[ChatType::HEARTBEAT]        = &ChatServer::onIgnore;   // counted as activity already
+    table[ChatType::SHM_ATTACH]       = &ChatServer::onShmAttach;
+    table[ChatType::NODE_HELLO]       = &ChatServer::onNodeHello;
+    table[ChatType::NODE_RELAY]       = &ChatServer::onNodeMessage;
+    table[ChatType::NODE_FANOUT]      = &ChatServer::onNodeMessage;
+    table[ChatType::NODE_SUBSCRIBE]   = &ChatServer::onNodeSubscription;
+    table[ChatType::NODE_UNSUBSCRIBE] = &ChatServer::onNodeSubscription;
+    table[ChatType::SEARCH]           = &ChatServer::onSearch;
+    return table;
+}
+
+constexpr std::array<ChatServer::PacketHandler, 256> ChatServer::kHandlers =
+    ChatServer::makeHandlers();
+
+void ChatServer::handleClient(int clientSock, std::uint32_t connId,
+                              const UpgradeConn* adopted) {
+    if (!ioCpus_.empty()) {
+        int cpu = ioCpus_[connId % ioCpus_.size()];
+        if (!pin_current_thread(cpu)) {
+            log_warn("Connection %u: cannot pin to cpu %d", connId, cpu);
+        }
+    }
+
+    auto session = std::allocate_shared<ConnSession>(
+        PoolAllocator<ConnSession>(session_pool()), clientSock);
+    {
+        std::lock_guard<std::mutex> lock(session->mtx);
+        session->timer = timers_.schedule(std::chrono::milliseconds(liveness_.heartbeatMs),
+                                       [this, session] { checkLiveness(session); });
+    }
+    ClientConn conn{clientSock, connId, session,
+                    TokenBucket(admission_.connRate, admission_.connBurst)};
+
+    // a packet the previous process had only partly read continues here
+    RecvBuffer buf;
+    if (adopted) {
+        std::memcpy(buf.data.get(), adopted->pending.data(), adopted->pending.size());
+        buf.end = adopted->pending.size();
+    }
+
+    // visible to handOff() for as long as this thread serves the connection
+    {
+        std::lock_guard<std::mutex> lock(connsMtx_);
+        conns_[connId] = ConnThread{session, pthread_self(), &buf};
+        --starting_;
+        handoffCv_.notify_all();
+    }
+    struct Unregister {
+        ChatServer* server;
+        std::uint32_t connId;
+        ~Unregister() {
+            std::lock_guard<std::mutex> lock(server->connsMtx_);
+            server->conns_.erase(connId);
+            server->handoffCv_.notify_all();
+        }
+    } unregister{this, connId};
+
+    if (adopted) {
+        {
+            std::lock_guard<std::mutex> lock(session->mtx);
+            std::snprintf(session->username, sizeof(session->username), "%s",
+                          adopted->username.c_str());
+            session->currentGroup = adopted->currentGroup;
+        }
+        if (adopted->joined &&
+            groups_.joinGroup(adopted->currentGroup, ClientInfo{clientSock, session->username})) {
+            setLocalMembers(adopted->currentGroup, true);
+        }
+    }
+
+    while (true) {
+        // every complete packet is handled by now; a partial one is handed over
+        parkIfHandingOff();
+
+        RecvStatus status = transport_recv(clientSock, buf);
+        if (status == RecvStatus::Interrupted) continue;
+        if (status == RecvStatus::Closed) {
+            // closed first: a JOIN still queued must not add us back afterwards
+            closeConn(conn);
+            if (session->isPeer) {
+                log_warn("Cluster: link from node %u closed", session->peerNode);
+                cluster_->dropNode(session->peerNode);
+            } else {
+                log_info("Connection %u disconnected", connId);
+                if (groups_.leaveGroup(session->currentGroup, clientSock)) {
+                    setLocalMembers(session->currentGroup, false);
                 }
-                break;
             }
-            default:
-                break;
+            return;
+        }
+
+        // any inbound packet (including a HEARTBEAT reply) proves liveness
+        session->lastActivityMs.store(now_ms(), std::memory_order_relaxed);
+        // a clock read per batch only while tracing is on
+        conn.recvUs = trace_sample_every() ? trace_now_us() : 0;
+
+        ChatPacket pkt;
+        while (buf.next(pkt)) {
+            // record the packet exactly as received (no-op unless --capture)
+            capture_record(connId, pkt);
+            if (!(this->*kHandlers[pkt.type])(conn, pkt, ntohs(pkt.groupID))) return;
+        }
+    }
+}
+
+// mark closed and drop the pending timer; the peer sees EOF now, the fd
+// itself is released with the last reference to the session
+void ChatServer::closeConn(ClientConn& conn) {
+    {
+        std::lock_guard<std::mutex> lock(conn.session->mtx);
+        conn.session->closed = true;
+        timers_.cancel(conn.session->timer);
+    }
+    shutdown(conn.sock, SHUT_RDWR);
+}
+
+// -------- packet handlers (false = connection finished) --------
+
+bool ChatServer::onIgnore(ClientConn&, ChatPacket&, uint16_t) {
+    return true;
+}
+
+bool ChatServer::onJoin(ClientConn& conn, ChatPacket& pkt, uint16_t groupId) {
+    auto& session = conn.session;
+    pkt.payload[sizeof(pkt.payload) - 1] = '\0';
+    {
+        std::lock_guard<std::mutex> lock(session->mtx);
+        std::memcpy(session->username, pkt.payload, sizeof(session->username));
+        session->currentGroup = groupId;
+    }
+    log_info("Connection %u joined group %u as '%s'",
+             conn.connId, groupId, session->username);
+    // Membership starts together with the history replay, under the group
+    // lock, so no message is both replayed and sent live. It is Control work:
+    // it must not queue behind other connections' fan-out.
+    enqueueReply(session, [this, session, groupId]() {
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock(session->mtx);
+            name = session->username;
         }
+        if (groups_.joinAndReplay(groupId, ClientInfo{session->sock, name}, session->closed)) {
+            setLocalMembers(groupId, true);
+        }
+    });
+    return true;
+}
+
+bool ChatServer::onMessage(ClientConn& conn, ChatPacket& pkt, uint16_t groupId) {
+    // admission control: drop rather than let the queue grow
+    if (!conn.limiter.tryConsume()) {
+        stats_record_throttled_conn();
+        return true;
+    }
+    if (!groupLimiter_.tryConsume(groupId)) {
+        stats_record_throttled_group();
+        return true;
+    }
+    if (inFlight_.load() >= admission_.maxInFlight ||
+        pool_.queueSize() >= admission_.shedQueueDepth) {
+        stats_record_shed();
+        return true;
+    }
+
+    // track stats
+    stats_record_message();
+    stats_vm_access(groupId);
+
+    // another node orders this group; it sends the message back to us
+    if (cluster_ && !cluster_->owns(groupId)) {
+        cluster_->relayToOwner(groupId, pkt);
+        return true;
+    }
+    std::uint32_t traceId = conn.recvUs ? trace_sample() : 0;
+    if (traceId) trace_span(traceId, TraceStage::Recv, conn.recvUs, trace_now_us(), groupId);
+    enqueueBroadcast(groupId, pkt, true, traceId, conn.session);
+    return true;
+}
+
+bool ChatServer::onLeave(ClientConn& conn, ChatPacket&, uint16_t groupId) {
+    log_info("Connection %u leaving group %u", conn.connId, groupId);
+    closeConn(conn);
+    if (groups_.leaveGroup(groupId, conn.sock)) {
+        setLocalMembers(groupId, false);
     }
+    return false;
+}
+
+bool ChatServer::onNodeHello(ClientConn& conn, ChatPacket& pkt, uint16_t) {
+    if (!cluster_) return true;
+    auto& session = conn.session;
+    pkt.payload[sizeof(pkt.payload) - 1] = '\0';
+    std::uint32_t node = static_cast<std::uint32_t>(std::strtoul(pkt.payload, nullptr, 10));
+
+    // relayed traffic skips admission control, so only a configured peer
+    // connecting from its own host may become a link
+    sockaddr_storage from{};
+    socklen_t len = sizeof(from);
+    getpeername(conn.sock, (sockaddr*)&from, &len);
+    if (!cluster_->authenticate(node, from)) {
+        log_warn("Cluster: connection %u claimed to be node %u from an address not configured "
+                 "for it, closing", conn.connId, node);
+        closeConn(conn);
+        if (groups_.leaveGroup(session->currentGroup, conn.sock)) {
+            setLocalMembers(session->currentGroup, false);
+        }
+        return false;
+    }
+
+    session->peerNode = node;
+    session->isPeer = true;
+    {
+        // inter-node links only carry traffic one way; never ping them
+        std::lock_guard<std::mutex> lock(session->mtx);
+        timers_.cancel(session->timer);
+    }
+    log_info("Cluster: connection %u is a link from node %u", conn.connId, session->peerNode);
+    return true;
+}
+
+bool ChatServer::onNodeMessage(ClientConn& conn, ChatPacket& pkt, uint16_t groupId) {
+    if (!conn.session->isPeer) return true;
+    // counted as a message by the node whose client sent it
+    stats_record_cluster_received();
+    bool owner = pkt.type == ChatType::NODE_RELAY;
+    pkt.type = ChatType::MESSAGE;
+    std::uint32_t traceId = conn.recvUs ? trace_sample() : 0;
+    if (traceId) trace_span(traceId, TraceStage::Recv, conn.recvUs, trace_now_us(), groupId);
+    if (owner) {
+        enqueueBroadcast(groupId, pkt, true, traceId);
+        return true;
+    }
+    // the owner's order is the order the link delivers; spreading NODE_FANOUT
+    // over several workers could swap neighbours, so send it from this thread
+    groups_.broadcastToGroup(groupId, pkt, traceId);
+    search_.add(groupId, pkt);
+    return true;
+}
+
+bool ChatServer::onNodeSubscription(ClientConn& conn, ChatPacket& pkt, uint16_t groupId) {
+    if (!conn.session->isPeer) return true;
+    stats_record_cluster_received();
+    if (pkt.type == ChatType::NODE_SUBSCRIBE) {
+        cluster_->addSubscriber(groupId, conn.session->peerNode);
+    } else {
+        cluster_->removeSubscriber(groupId, conn.session->peerNode);
+    }
+    return true;
+}
+
+bool ChatServer::onShmAttach(ClientConn& conn, ChatPacket& pkt, uint16_t) {
+    // only peers that reached us over the Unix socket share our host
+    sockaddr_storage local{};
+    socklen_t len = sizeof(local);
+    getsockname(conn.sock, (sockaddr*)&local, &len);
+
+    pkt.payload[sizeof(pkt.payload) - 1] = '\0';
+    bool ok = local.ss_family == AF_UNIX &&
+              transport_attach_shm(conn.sock, pkt.payload);
+    log_info("Connection %u %s shared memory transport %s", conn.connId,
+             ok ? "switched to" : "could not attach", pkt.payload);
+
+    // first packet over the new transport (or the socket, on failure)
+    ChatPacket resp{};
+    resp.type = ChatType::SYSTEM;
+    resp.timestamp = htonl(current_timestamp());
+    std::snprintf(resp.payload, sizeof(resp.payload), "%s",
+                  ok ? "shm attached" : "shm attach failed");
+    transport_send(conn.sock, resp);
+    return true;
+}
+
+bool ChatServer::onListGroups(ClientConn& conn, ChatPacket& pkt, uint16_t) {
+    // optional page number in the payload, 1-based
+    pkt.payload[sizeof(pkt.payload) - 1] = '\0';
+    long requested = std::strtol(pkt.payload, nullptr, 10);
+    std::size_t page = requested > 1 ? static_cast<std::size_t>(requested - 1) : 0;
+
+    auto session = conn.session;
+    enqueueReply(session, [this, session, page]() {
+        if (session->closed) return;
+        // one packet from the lock-free snapshot, however busy the server is
+        auto dir = groups_.directory();
+        ChatPacket resp{};
+        resp.type = ChatType::SYSTEM;
+        {
+            std::lock_guard<std::mutex> lock(session->mtx);
+            resp.groupID = htons(session->currentGroup);
+        }
+        resp.timestamp = htonl(current_timestamp());
+        formatGroupPage(*dir, page, resp.payload, sizeof(resp.payload));
+        transport_send(session->sock, resp);
+    });
+    return true;
+}
+
+bool ChatServer::onSearch(ClientConn& conn, ChatPacket& pkt, uint16_t groupId) {
+    pkt.payload[sizeof(pkt.payload) - 1] = '\0';
+    std::string query = pkt.payload;
+
+    auto session = conn.session;
+    enqueueReply(session, [this, session, groupId, query]() {
+        if (session->closed) return;
+        auto start = std::chrono::steady_clock::now();
+        std::size_t total = 0;
+        auto hits = search_.query(groupId, query, kSearchResults, total);
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        stats_record_search(static_cast<std::uint64_t>(us), total);
+
+        // results and summary in one write, so no broadcast lands between them
+        std::size_t shown = hits.size();
+        ChatPacket& resp = hits.emplace_back();
+        resp.type = ChatType::SYSTEM;
+        resp.groupID = htons(groupId);
+        resp.timestamp = htonl(current_timestamp());
+        std::snprintf(resp.payload, sizeof(resp.payload),
+                      "Search '%.160s' in group %u: %zu of %zu matches",
+                      query.c_str(), groupId, shown, total);
+        transport_send_batch(session->sock, hits.data(), hits.size());
+    });
+    return true;
 }
@@ -1,19 +1,121 @@
 #pragma once
 #include "group_manager.h"
 #include "thread_pool.h"
+#include "rate_limiter.h"
+#include "timer_wheel.h"
+#include "cpu_affinity.h"
+#include "cluster.h"
+#include "hot_upgrade.h"
+#include "search_index.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <pthread.h>
+
+// Application-level liveness: a connection that has sent nothing for
+// heartbeatMs gets a HEARTBEAT ping; one that stays silent for
+// idleTimeoutMs is shut down and removed from its group.
+struct LivenessConfig {
+    int heartbeatMs   = 30000;
+    int idleTimeoutMs = 90000;
+};
+
+struct ConnSession;
+struct RecvBuffer;
 
 class ChatServer {
 public:
-    ChatServer(int port, std::size_t workerThreads = 4);
+    ChatServer(int port, const PoolSizing& workers = PoolSizing(),
+               const AdmissionConfig& admission = AdmissionConfig(),
+               const LivenessConfig& liveness = LivenessConfig(),
+               const AffinityConfig& affinity = AffinityConfig(),
+               unsigned controlWeight = 0);   // see ThreadPool
     ~ChatServer();
 
+    // also accept connections on a Unix domain socket (call before run)
+    void listenUnix(const std::string& path) { unixPath_ = path; }
+
+    // federate with other nodes (call before run)
+    void enableCluster(const ClusterConfig& config) {
+        cluster_ = std::make_unique<Cluster>(config);
+    }
+
+    // take over from a server already listening on `path` (if any) and let
+    // the next binary take over from us the same way (call before run)
+    void enableHotUpgrade(const std::string& path) { upgradePath_ = path; }
+
     void run();     // blocking accept loop
 
 private:
     int port_;
     int server_fd_;
+    int unix_fd_;
+    std::string unixPath_;
     GroupManager groups_;
+    SearchIndex search_;                  // fed by the fan-out tasks, indexed on its own thread
     ThreadPool pool_;
+    AdmissionConfig admission_;
+    GroupRateLimiter groupLimiter_;
+    std::atomic<std::size_t> inFlight_;   // broadcasts queued or running
+    LivenessConfig liveness_;
+    TimerWheel timers_;
+    std::vector<int> ioCpus_;
+    std::unique_ptr<Cluster> cluster_;    // null when running standalone
+    std::atomic<std::uint32_t> nextConnId_;
+
+    // hot upgrade: live connection threads, which park while we hand off
+    struct ConnThread {
+        std::shared_ptr<ConnSession> session;
+        pthread_t thread;
+        const RecvBuffer* buf;   // read by handOff only while the thread is parked
+    };
+    std::string upgradePath_;
+    int upgrade_fd_;
+    std::mutex connsMtx_;
+    std::map<std::uint32_t, ConnThread> conns_;
+    std::condition_variable handoffCv_;   // with connsMtx_
+    std::atomic<bool> handingOff_;
+    std::size_t parked_;
+    std::size_t starting_;                // accepted, thread not yet in conns_
+
+    void handleClient(int clientSock, std::uint32_t connId,
+                      const UpgradeConn* adopted = nullptr);
+
+    // Packet dispatch: one handler per ChatType, in a table built at compile
+    // time. groupId is already in host order; false = connection finished.
+    struct ClientConn;
+    using PacketHandler = bool (ChatServer::*)(ClientConn&, ChatPacket&, uint16_t groupId);
+    static constexpr std::array<PacketHandler, 256> makeHandlers();
+    static const std::array<PacketHandler, 256> kHandlers;
+
+    bool onIgnore(ClientConn& conn, ChatPacket& pkt, uint16_t groupId);
+    bool onJoin(ClientConn& conn, ChatPacket& pkt, uint16_t groupId);
+    bool onMessage(ClientConn& conn, ChatPacket& pkt, uint16_t groupId);
+    bool onLeave(ClientConn& conn, ChatPacket& pkt, uint16_t groupId);
+    bool onListGroups(ClientConn& conn, ChatPacket& pkt, uint16_t groupId);
+    bool onShmAttach(ClientConn& conn, ChatPacket& pkt, uint16_t groupId);
+    bool onNodeHello(ClientConn& conn, ChatPacket& pkt, uint16_t groupId);
+    bool onNodeMessage(ClientConn& conn, ChatPacket& pkt, uint16_t groupId);
+    bool onNodeSubscription(ClientConn& conn, ChatPacket& pkt, uint16_t groupId);
+    bool onSearch(ClientConn& conn, ChatPacket& pkt, uint16_t groupId);
+    void closeConn(ClientConn& conn);
 
-    void handleClient(int clientSock);
+    void checkLiveness(const std::shared_ptr<ConnSession>& conn);
+    bool openTcpListener();
+    bool openUnixListener();
+    bool takeOver();
+    void handOff(int ctl);
+    void parkIfHandingOff();
+    void enqueueBroadcast(uint16_t groupId, const ChatPacket& pkt, bool owner,
+                          std::uint32_t traceId = 0,
+                          const std::shared_ptr<ConnSession>& sender = nullptr);
+    void enqueueReply(const std::shared_ptr<ConnSession>& session, std::function<void()> task);
+    void releaseReplies(ConnSession& session);
+    void setLocalMembers(uint16_t groupId, bool present);
 };
@@ -0,0 +1,320 @@
+// Server/cluster.cpp
+#include "cluster.h"
+#include "perf_stats.h"
+#include "async_log.h"
+#include "../Shared/utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr auto kReconnectDelay = std::chrono::milliseconds(500);
+
+// murmur3 finalizer: spreads small consecutive ids over the whole ring
+std::uint32_t mix32(std::uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+std::uint32_t ringPoint(std::uint32_t node, unsigned vnode) {
+    return mix32(node * 0x9e3779b9u ^ mix32(vnode + 1));
+}
+
+} // namespace
+
+Cluster::Cluster(const ClusterConfig& config) : config_(config) {
+    std::vector<std::uint32_t> nodes{config_.nodeId};
+    for (const auto& p : config_.peers) nodes.push_back(p.id);
+    for (std::uint32_t n : nodes) {
+        for (unsigned v = 0; v < config_.virtualNodes; ++v) {
+            ring_.emplace_back(ringPoint(n, v), n);
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+
+    for (const auto& p : config_.peers) {
+        auto link = std::make_unique<Link>();
+        link->peer = p;
+        link->wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        links_.emplace(p.id, std::move(link));
+    }
+    // start the writers only once links_ is complete: it is read unlocked
+    for (auto& kv : links_) {
+        kv.second->thread = std::thread(&Cluster::linkLoop, this, std::ref(*kv.second));
+    }
+}
+
+Cluster::~Cluster() {
+    stop_ = true;
+    for (auto& kv : links_) {
+        Link& link = *kv.second;
+        {
+            std::lock_guard<std::mutex> lock(link.mtx);
+            if (link.sock >= 0) shutdown(link.sock, SHUT_RDWR);
+        }
+        link.cv.notify_all();
+        eventfd_write(link.wakeFd, 1);
+        if (link.thread.joinable()) link.thread.join();
+        if (link.sock >= 0) close(link.sock);
+        close(link.wakeFd);
+    }
+}
+
+bool Cluster::parsePeer(const std::string& spec, PeerNode& out) {
+    std::size_t eq = spec.find('=');
+    std::size_t colon = spec.rfind(':');
+    if (eq == std::string::npos || colon == std::string::npos || colon < eq) return false;
+    try {
+        out.id   = static_cast<std::uint32_t>(std::stoul(spec.substr(0, eq)));
+        out.host = spec.substr(eq + 1, colon - eq - 1);
+        out.port = std::stoi(spec.substr(colon + 1));
+    } catch (...) {
+        return false;
+    }
+    return !out.host.empty() && out.port > 0;
+}
+
+std::uint32_t Cluster::ownerOf(std::uint16_t groupId) const {
+    std::uint32_t h = mix32(groupId);
+    auto it = std::lower_bound(ring_.begin(), ring_.end(),
+                               std::make_pair(h, std::uint32_t{0}));
+    if (it == ring_.end()) it = ring_.begin();
+    return it->second;
+}
+
+// Links are dialled over IPv4 (connectLink), so anything else is a client.
+// The host is resolved again on every HELLO; links are long-lived.
+bool Cluster::authenticate(std::uint32_t node, const sockaddr_storage& from) const {
+    auto it = links_.find(node);
+    if (it == links_.end() || from.ss_family != AF_INET) return false;
+    const in_addr& addr = reinterpret_cast<const sockaddr_in&>(from).sin_addr;
+
+    addrinfo hints{};
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(it->second->peer.host.c_str(), nullptr, &hints, &res) != 0) return false;
+    bool match = false;
+    for (addrinfo* ai = res; ai && !match; ai = ai->ai_next) {
+        match = reinterpret_cast<const sockaddr_in*>(ai->ai_addr)->sin_addr.s_addr == addr.s_addr;
+    }
+    freeaddrinfo(res);
+    return match;
+}
+
+void Cluster::relayToOwner(std::uint16_t groupId, const ChatPacket& pkt) {
+    queue(ownerOf(groupId), ChatType::NODE_RELAY, groupId, &pkt);
+}
+
+void Cluster::fanout(std::uint16_t groupId, const ChatPacket& pkt) {
+    std::vector<std::uint32_t> targets;
+    {
+        std::lock_guard<std::mutex> lock(subsMtx_);
+        auto it = subscribers_.find(groupId);
+        if (it == subscribers_.end()) return;
+        targets.assign(it->second.begin(), it->second.end());
+    }
+    for (std::uint32_t node : targets) {
+        queue(node, ChatType::NODE_FANOUT, groupId, &pkt);
+    }
+}
+
+void Cluster::setLocalMembers(std::uint16_t groupId, bool present) {
+    {
+        std::lock_guard<std::mutex> lock(subsMtx_);
+        if (present) localGroups_.insert(groupId);
+        else         localGroups_.erase(groupId);
+    }
+    std::uint32_t owner = ownerOf(groupId);
+    if (owner == config_.nodeId) return;
+    queue(owner, present ? ChatType::NODE_SUBSCRIBE : ChatType::NODE_UNSUBSCRIBE,
+          groupId, nullptr);
+}
+
+void Cluster::addSubscriber(std::uint16_t groupId, std::uint32_t node) {
+    std::lock_guard<std::mutex> lock(subsMtx_);
+    subscribers_[groupId].insert(node);
+}
+
+void Cluster::removeSubscriber(std::uint16_t groupId, std::uint32_t node) {
+    std::lock_guard<std::mutex> lock(subsMtx_);
+    auto it = subscribers_.find(groupId);
+    if (it == subscribers_.end()) return;
+    it->second.erase(node);
+    if (it->second.empty()) subscribers_.erase(it);
+}
+
+void Cluster::dropNode(std::uint32_t node) {
+    std::lock_guard<std::mutex> lock(subsMtx_);
+    for (auto it = subscribers_.begin(); it != subscribers_.end();) {
+        it->second.erase(node);
+        it = it->second.empty() ? subscribers_.erase(it) : std::next(it);
+    }
+}
+
+void Cluster::queue(std::uint32_t node, std::uint8_t type, std::uint16_t groupId,
+                    const ChatPacket* body) {
+    auto it = links_.find(node);
+    if (it == links_.end()) return;   // ourselves, or an unknown node
+    Link& link = *it->second;
+
+    ChatPacket pkt{};
+    if (body) pkt = *body;
+    pkt.type    = type;
+    pkt.groupID = htons(groupId);
+
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(link.mtx);
+        if (link.outBuf.size() >= config_.maxQueuedPackets * sizeof(ChatPacket)) {
+            stats_record_cluster_dropped(1);
+            return;
+        }
+        wasEmpty = link.outBuf.empty();
+        link.outBuf.append(reinterpret_cast<const char*>(&pkt), sizeof(pkt));
+    }
+    // the writer already has work pending otherwise
+    if (wasEmpty) eventfd_write(link.wakeFd, 1);
+}
+
+bool Cluster::connectLink(Link& link) {
+    addrinfo hints{};
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    std::string port = std::to_string(link.peer.port);
+    if (getaddrinfo(link.peer.host.c_str(), port.c_str(), &hints, &res) != 0) return false;
+
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    bool ok = sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+    if (!ok) {
+        if (sock >= 0) close(sock);
+        return false;
+    }
+
+    // batching happens in outBuf; don't let Nagle add latency on top
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // announce ourselves, then (re-)subscribe to every group it owns that we need
+    std::string hello;
+    ChatPacket pkt{};
+    pkt.type = ChatType::NODE_HELLO;
+    pkt.timestamp = htonl(current_timestamp());
+    std::snprintf(pkt.payload, sizeof(pkt.payload), "%u", config_.nodeId);
+    hello.append(reinterpret_cast<const char*>(&pkt), sizeof(pkt));
+    {
+        std::lock_guard<std::mutex> lock(subsMtx_);
+        for (std::uint16_t g : localGroups_) {
+            if (ownerOf(g) != link.peer.id) continue;
+            ChatPacket sub{};
+            sub.type = ChatType::NODE_SUBSCRIBE;
+            sub.groupID = htons(g);
+            hello.append(reinterpret_cast<const char*>(&sub), sizeof(sub));
+        }
+    }
+    if (!send_all(sock, hello.data(), hello.size())) {
+        close(sock);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(link.mtx);
+    link.sock = sock;
+    return true;
+}
+
+// Sleeps until there is something to send. Peers never write on our
+// outbound link, so the socket turning readable means EOF (the peer went
+// away) or a reset; anything actually readable is discarded.
+bool Cluster::waitForWork(Link& link) {
+    while (!stop_) {
+        {
+            std::lock_guard<std::mutex> lock(link.mtx);
+            if (!link.outBuf.empty()) return true;
+        }
+
+        pollfd pfds[2] = {{link.sock, POLLIN, 0}, {link.wakeFd, POLLIN, 0}};
+        if (poll(pfds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (pfds[1].revents & POLLIN) {
+            eventfd_t n;
+            eventfd_read(link.wakeFd, &n);
+        }
+        if (pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            char junk[sizeof(ChatPacket)];
+            ssize_t n = recv(link.sock, junk, sizeof(junk), MSG_DONTWAIT);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Cluster::dropLink(Link& link, std::size_t lostPackets) {
+    log_warn("Cluster: link to node %u lost", link.peer.id);
+    if (lostPackets) stats_record_cluster_dropped(lostPackets);
+    std::lock_guard<std::mutex> lock(link.mtx);
+    close(link.sock);
+    link.sock = -1;
+}
+
+void Cluster::linkLoop(Link& link) {
+    bool warned = false;
+    std::string batch;
+
+    while (!stop_) {
+        if (link.sock < 0) {
+            if (!connectLink(link)) {
+                if (!warned) {
+                    log_warn("Cluster: node %u (%s:%d) unreachable, retrying", link.peer.id,
+                             link.peer.host.c_str(), link.peer.port);
+                    warned = true;
+                }
+                std::unique_lock<std::mutex> lock(link.mtx);
+                link.cv.wait_for(lock, kReconnectDelay, [this] { return stop_.load(); });
+                continue;
+            }
+            log_info("Cluster: link to node %u up", link.peer.id);
+            warned = false;
+        }
+
+        // on EOF redial straight away: connectLink resubscribes our groups
+        if (!waitForWork(link)) {
+            if (!stop_) dropLink(link, 0);
+            continue;
+        }
+        if (stop_) break;
+        {
+            std::lock_guard<std::mutex> lock(link.mtx);
+            batch.swap(link.outBuf);   // everything queued so far goes in one send
+        }
+
+        std::size_t packets = batch.size() / sizeof(ChatPacket);
+        if (!send_all(link.sock, batch.data(), batch.size())) {
+            dropLink(link, packets);
+        } else {
+            stats_record_cluster_batch(packets);
+        }
+        batch.clear();
+    }
+}
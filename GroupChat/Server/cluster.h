@@ -0,0 +1,111 @@
+// Server/cluster.h
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sys/socket.h>
+#include "../Shared/protocol.h"
+
+// Multi-node federation.
+//
+// Every node knows the same static peer list. Each group is owned by one
+// node, chosen by consistent hashing over all node ids, and the owner orders
+// the group's traffic:
+//
+//   - a MESSAGE received on a non-owner is relayed to the owner (NODE_RELAY);
+//   - the owner broadcasts it to its own members and forwards one copy to
+//     every node that has subscribed to the group (NODE_FANOUT), which then
+//     broadcasts it to its local members;
+//   - a node subscribes to a group's owner while it has local members in it
+//     (NODE_SUBSCRIBE / NODE_UNSUBSCRIBE).
+//
+// Each node dials one outbound link per peer on the peer's normal client
+// port and announces itself with NODE_HELLO; inbound links are ordinary
+// connections on our side that handleClient recognises by that packet. A
+// HELLO is only accepted for a configured peer id, from that peer's host.
+// Packets for a peer are appended to the link's buffer and a writer thread
+// sends everything queued with one send(), so forwarding is batched under
+// load. A link that is down keeps buffering (bounded) and reconnects. The
+// writer also watches the socket, so a peer that restarts is redialled (and
+// resubscribed) as soon as its side of the link closes, not on the next send.
+
+struct PeerNode {
+    std::uint32_t id;
+    std::string   host;
+    int           port;
+};
+
+struct ClusterConfig {
+    std::uint32_t         nodeId = 0;
+    std::vector<PeerNode> peers;
+    unsigned              virtualNodes     = 64;      // ring points per node
+    std::size_t           maxQueuedPackets = 65536;   // per link, then drop
+};
+
+class Cluster {
+public:
+    explicit Cluster(const ClusterConfig& config);
+    ~Cluster();
+
+    Cluster(const Cluster&) = delete;
+    Cluster& operator=(const Cluster&) = delete;
+
+    // "2=10.0.0.2:8080"
+    static bool parsePeer(const std::string& spec, PeerNode& out);
+
+    std::uint32_t nodeId() const { return config_.nodeId; }
+    std::uint32_t ownerOf(std::uint16_t groupId) const;
+    bool owns(std::uint16_t groupId) const { return ownerOf(groupId) == config_.nodeId; }
+
+    // true if `from` is an address of the configured peer `node`
+    bool authenticate(std::uint32_t node, const sockaddr_storage& from) const;
+
+    // non-owner: hand a client's MESSAGE to the group's owner
+    void relayToOwner(std::uint16_t groupId, const ChatPacket& pkt);
+    // owner: copy an ordered, timestamped MESSAGE to every subscribed node
+    void fanout(std::uint16_t groupId, const ChatPacket& pkt);
+
+    // this node gained its first / lost its last local member of a group
+    void setLocalMembers(std::uint16_t groupId, bool present);
+
+    // owner side of NODE_SUBSCRIBE / NODE_UNSUBSCRIBE, and inbound link loss
+    void addSubscriber(std::uint16_t groupId, std::uint32_t node);
+    void removeSubscriber(std::uint16_t groupId, std::uint32_t node);
+    void dropNode(std::uint32_t node);
+
+private:
+    struct Link {
+        PeerNode                peer;
+        std::mutex              mtx;
+        std::condition_variable cv;       // reconnect back-off, woken by stop
+        std::string             outBuf;   // encoded packets not yet sent
+        std::thread             thread;
+        int                     sock = -1;
+        int                     wakeFd = -1;   // eventfd: outBuf became non-empty, or stop
+    };
+
+    ClusterConfig config_;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ring_;   // (hash, node), sorted
+    std::map<std::uint32_t, std::unique_ptr<Link>> links_;        // by peer id; fixed after ctor
+    std::atomic<bool> stop_{false};
+
+    std::mutex subsMtx_;
+    std::map<std::uint16_t, std::set<std::uint32_t>> subscribers_;   // groups we own
+    std::set<std::uint16_t> localGroups_;                            // groups with local members
+
+    void queue(std::uint32_t node, std::uint8_t type, std::uint16_t groupId,
+               const ChatPacket* body);
+    void linkLoop(Link& link);
+    bool connectLink(Link& link);
+    bool waitForWork(Link& link);   // false = the peer closed the link
+    void dropLink(Link& link, std::size_t lostPackets);
+};
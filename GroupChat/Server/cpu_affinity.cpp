@@ -0,0 +1,122 @@
+// Server/cpu_affinity.cpp
+#include "cpu_affinity.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kMpolPreferred = 1;   // <linux/mempolicy.h>, without needing libnuma
+
+std::atomic<bool> g_placement{false};
+
+std::size_t pageRound(std::size_t bytes) {
+    std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return (bytes + page - 1) / page * page;
+}
+
+bool parseRange(const std::string& part, std::vector<int>& out) {
+    std::size_t dash = part.find('-');
+    char* end = nullptr;
+    long lo = std::strtol(part.c_str(), &end, 10);
+    if (end == part.c_str() || lo < 0) return false;
+    long hi = lo;
+    if (dash != std::string::npos) {
+        const char* hiStr = part.c_str() + dash + 1;
+        hi = std::strtol(hiStr, &end, 10);
+        if (end == hiStr || hi < lo) return false;
+    }
+    for (long c = lo; c <= hi; ++c) out.push_back(static_cast<int>(c));
+    return true;
+}
+
+} // namespace
+
+std::vector<int> parse_cpu_list(const std::string& spec) {
+    if (spec.compare(0, 5, "node:") == 0) {
+        std::ifstream in("/sys/devices/system/node/node" + spec.substr(5) + "/cpulist");
+        std::string list;
+        if (!in || !std::getline(in, list)) return {};
+        return parse_cpu_list(list);
+    }
+
+    std::vector<int> cpus;
+    std::stringstream ss(spec);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        if (part.empty()) continue;
+        if (!parseRange(part, cpus)) return {};
+    }
+    return cpus;
+}
+
+bool pin_current_thread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+int current_cpu() {
+    return sched_getcpu();
+}
+
+int numa_node_of_cpu(int cpu) {
+    if (cpu < 0) return 0;
+    // each cpuN directory has a nodeM link to its node
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return 0;
+    int node = 0;
+    while (dirent* e = readdir(dir)) {
+        if (std::strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9') {
+            node = std::atoi(e->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+void numa_set_placement(bool enabled) {
+    g_placement.store(enabled, std::memory_order_relaxed);
+}
+
+void* numa_alloc_local(std::size_t bytes) {
+    if (!g_placement.load(std::memory_order_relaxed)) return ::operator new(bytes);
+
+    std::size_t len = pageRound(bytes);
+    void* mem = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) throw std::bad_alloc();
+
+    int node = numa_node_of_cpu(current_cpu());
+    unsigned long mask[4] = {};   // up to 256 nodes
+    if (node >= 0 && node < static_cast<int>(sizeof(mask) * 8)) {
+        mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+        // best effort: on a kernel without NUMA support first touch below still applies
+        syscall(SYS_mbind, mem, len, kMpolPreferred, mask, sizeof(mask) * 8, 0);
+    }
+    std::memset(mem, 0, len);   // fault the pages in now, from this thread
+    return mem;
+}
+
+void numa_free(void* p, std::size_t bytes) {
+    if (!p) return;
+    if (!g_placement.load(std::memory_order_relaxed)) {
+        ::operator delete(p);
+        return;
+    }
+    munmap(p, pageRound(bytes));
+}
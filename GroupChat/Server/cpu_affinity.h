@@ -0,0 +1,58 @@
+// Server/cpu_affinity.h
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Thread placement for the server.
+//
+// Worker and I/O threads can be pinned to fixed CPU sets so a thread's
+// caches and stack stay on one core (and one NUMA node). When pinning is
+// configured, group state is allocated on the NUMA node of the thread that
+// creates it (see NumaAllocator) instead of wherever malloc's arena lives.
+//
+// An empty CPU list means "don't pin"; that is the default.
+
+struct AffinityConfig {
+    std::vector<int> workerCpus;   // ThreadPool worker i -> workerCpus[i % size]
+    std::vector<int> ioCpus;       // connection thread n -> ioCpus[n % size]
+};
+
+// "0-3,8,10-11" or "node:1" (every CPU of NUMA node 1). Empty on error.
+std::vector<int> parse_cpu_list(const std::string& spec);
+
+// Pin the calling thread; false if the CPU doesn't exist or isn't allowed.
+bool pin_current_thread(int cpu);
+
+int current_cpu();                 // -1 if unknown
+int numa_node_of_cpu(int cpu);     // 0 on single-node (or non-NUMA) systems
+
+// Node-local allocation. With placement enabled, memory comes from mmap()
+// bound to the calling thread's node and is touched before it is returned;
+// otherwise these are plain operator new/delete. Set placement once at
+// startup, before anything has been allocated through it.
+void  numa_set_placement(bool enabled);
+void* numa_alloc_local(std::size_t bytes);
+void  numa_free(void* p, std::size_t bytes);
+
+template <typename T>
+struct NumaAllocator {
+    using value_type = T;
+
+    NumaAllocator() = default;
+    template <typename U>
+    NumaAllocator(const NumaAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(numa_alloc_local(n * sizeof(T)));
+    }
+    void deallocate(T* p, std::size_t n) {
+        numa_free(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const NumaAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const NumaAllocator<U>&) const { return false; }
+};
@@ -1,39 +1,103 @@
 #include "group_manager.h"
 #include "../Shared/utils.h"
+#include "transport.h"
+#include "msg_trace.h"
 #include <algorithm>
 #include <arpa/inet.h>
 
 GroupManager::GroupManager(std::size_t cacheSize)
-    : cacheSize_(cacheSize) {}
+    : cacheSize_(cacheSize),
+      directory_(std::make_shared<const GroupDirectory>()) {}
 
-void GroupManager::joinGroup(uint16_t groupId, const ClientInfo& client) {
+bool GroupManager::joinGroup(uint16_t groupId, const ClientInfo& client) {
     std::lock_guard<std::mutex> lock(mtx_);
-    groups_[groupId].push_back(client);
+    return joinLocked(groupId, client);
+}
+
+bool GroupManager::joinAndReplay(uint16_t groupId, const ClientInfo& client,
+                                 const std::atomic<bool>& cancelled) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    // set before the owner's leaveGroup() takes mtx_, so a join that loses
+    // that race sees it here
+    if (cancelled.load()) return false;
+    bool first = joinLocked(groupId, client);
+
+    std::vector<ChatPacket> history;
+    history.reserve(cacheSize_);
+    caches_.at(groupId).forEach([&history](const ChatPacket& pkt) { history.push_back(pkt); });
+    transport_send_batch(client.socket, history.data(), history.size());
+    return first;
+}
+
+bool GroupManager::joinLocked(uint16_t groupId, const ClientInfo& client) {
+    auto& members = groups_[groupId];
+    members.push_back(client);
+    bool first = members.size() == 1;
     if (!caches_.count(groupId)) {
-        caches_.emplace(groupId, CircularCache<ChatPacket>(cacheSize_));
+        caches_.emplace(groupId, GroupCache(cacheSize_));
     }
+    auto& act = activity_[groupId];
+    if (!act) act = std::make_shared<GroupActivity>();
+    act->lastActivity.store(current_timestamp(), std::memory_order_relaxed);
+    publishDirectory();
+    return first;
 }
 
-void GroupManager::leaveGroup(uint16_t groupId, int socket) {
+bool GroupManager::leaveGroup(uint16_t groupId, int socket) {
     std::lock_guard<std::mutex> lock(mtx_);
     auto it = groups_.find(groupId);
-    if (it == groups_.end()) return;
+    if (it == groups_.end()) return false;
     auto& vec = it->second;
-    vec.erase(std::remove_if(vec.begin(), vec.end(),
-                             [socket](const ClientInfo& c) { return c.socket == socket; }),
-              vec.end());
+    auto end = std::remove_if(vec.begin(), vec.end(),
+                              [socket](const ClientInfo& c) { return c.socket == socket; });
+    if (end == vec.end()) return false;   // wasn't a member, directory unchanged
+    vec.erase(end, vec.end());
+
+    // prune empty groups from the directory (history stays in caches_)
+    bool last = vec.empty();
+    if (last) {
+        groups_.erase(it);
+        activity_.erase(groupId);
+    }
+    publishDirectory();
+    return last;
 }
 
-void GroupManager::broadcastToGroup(uint16_t groupId, const ChatPacket& packet) {
+void GroupManager::broadcastToGroup(uint16_t groupId, const ChatPacket& original,
+                                    uint32_t traceId, const BroadcastHook& ordered) {
     std::lock_guard<std::mutex> lock(mtx_);
+    ChatPacket stamped;
+    const ChatPacket* pkt = &original;
+    if (ordered) {
+        stamped = original;
+        ordered(stamped);
+        pkt = &stamped;
+    }
+    const ChatPacket& packet = *pkt;
+
     auto it = groups_.find(groupId);
     if (it == groups_.end()) return;
 
     // cache copy in host order
+    uint64_t pushUs = traceId ? trace_now_us() : 0;
     caches_[groupId].push(packet);
+    if (traceId) trace_span(traceId, TraceStage::CachePush, pushUs, trace_now_us(), groupId);
+
+    auto act = activity_.find(groupId);
+    if (act != activity_.end()) {
+        act->second->lastActivity.store(current_timestamp(), std::memory_order_relaxed);
+    }
 
+    if (!traceId) {
+        for (const auto& client : it->second) {
+            transport_send(client.socket, packet);
+        }
+        return;
+    }
     for (const auto& client : it->second) {
-        send_all(client.socket, &packet, sizeof(ChatPacket));
+        uint64_t sendUs = trace_now_us();
+        transport_send(client.socket, packet);
+        trace_span(traceId, TraceStage::Send, sendUs, trace_now_us(), groupId, client.socket);
     }
 }
 
@@ -43,14 +107,55 @@ void GroupManager::sendRecentMessages(uint16_t groupId, int socket) {
     if (it == caches_.end()) return;
 
     it->second.forEach([socket](const ChatPacket& pkt) {
-        send_all(socket, &pkt, sizeof(ChatPacket));
+        transport_send(socket, pkt);
     });
 }
 
 std::vector<uint16_t> GroupManager::listGroups() const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    auto dir = directory();
     std::vector<uint16_t> ids;
-    ids.reserve(groups_.size());
-    for (auto& kv : groups_) ids.push_back(kv.first);
+    ids.reserve(dir->groups.size());
+    for (auto& g : dir->groups) ids.push_back(g.groupId);
     return ids;
 }
+
+std::shared_ptr<const GroupDirectory> GroupManager::directory() const {
+    return std::atomic_load(&directory_);
+}
+
+void GroupManager::publishDirectory() {
+    auto next = std::make_shared<GroupDirectory>();
+    next->version = ++directoryVersion_;
+    next->groups.reserve(groups_.size());
+    for (auto& kv : groups_) {
+        next->groups.push_back(GroupDirectoryEntry{
+            kv.first, static_cast<uint32_t>(kv.second.size()), activity_[kv.first]});
+    }
+    std::atomic_store(&directory_, std::shared_ptr<const GroupDirectory>(std::move(next)));
+}
+
+std::vector<std::pair<uint16_t, int>> GroupManager::memberSockets() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<std::pair<uint16_t, int>> out;
+    for (const auto& kv : groups_) {
+        for (const auto& c : kv.second) out.emplace_back(kv.first, c.socket);
+    }
+    return out;
+}
+
+std::map<uint16_t, std::vector<ChatPacket>> GroupManager::history() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::map<uint16_t, std::vector<ChatPacket>> out;
+    for (const auto& kv : caches_) {
+        auto& packets = out[kv.first];
+        kv.second.forEach([&packets](const ChatPacket& pkt) { packets.push_back(pkt); });
+    }
+    return out;
+}
+
+void GroupManager::restoreHistory(uint16_t groupId, const std::vector<ChatPacket>& packets) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = caches_.find(groupId);
+    if (it == caches_.end()) it = caches_.emplace(groupId, GroupCache(cacheSize_)).first;
+    for (const auto& pkt : packets) it->second.push(pkt);
+}
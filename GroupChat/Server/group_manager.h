@@ -3,28 +3,83 @@
 #include <vector>
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <functional>
 #include "../Shared/protocol.h"
 #include "../Shared/cache.h"
+#include "cpu_affinity.h"
 
 struct ClientInfo {
     int socket;
     std::string name;
 };
 
+// Last broadcast time for one group (epoch seconds). Shared with directory
+// snapshots so readers see fresh activity without a new snapshot per message.
+struct GroupActivity {
+    std::atomic<uint32_t> lastActivity{0};
+};
+
+struct GroupDirectoryEntry {
+    uint16_t groupId;
+    uint32_t members;
+    std::shared_ptr<const GroupActivity> activity;
+};
+
+// Immutable view of all non-empty groups, sorted by id. A new one is
+// published on every join/leave; readers never take the GroupManager lock.
+struct GroupDirectory {
+    uint64_t version = 0;
+    std::vector<GroupDirectoryEntry> groups;
+};
+
 class GroupManager {
 public:
     explicit GroupManager(std::size_t cacheSize = 50);
 
-    void joinGroup(uint16_t groupId, const ClientInfo& client);
-    void leaveGroup(uint16_t groupId, int socket);
-    void broadcastToGroup(uint16_t groupId, const ChatPacket& packet);
+    // true if the client is the group's first member
+    bool joinGroup(uint16_t groupId, const ClientInfo& client);
+    // joinGroup plus sendRecentMessages in one critical section: every
+    // broadcast is either in the replay or sent live after it, never both.
+    // Does nothing (false) if `cancelled` is set once the lock is held.
+    bool joinAndReplay(uint16_t groupId, const ClientInfo& client,
+                       const std::atomic<bool>& cancelled);
+    // true if this removed the group's last member
+    bool leaveGroup(uint16_t groupId, int socket);
+    // Runs under the group lock before the cache push and the sends (even
+    // when the group has no local members here) and may rewrite the packet.
+    // Two broadcasts reach the hook, the cache and every member in the same
+    // order, so anything the hook forwards is ordered like the local copies.
+    using BroadcastHook = std::function<void(ChatPacket&)>;
+
+    // traceId != 0: record cache_push and per-recipient send spans
+    void broadcastToGroup(uint16_t groupId, const ChatPacket& packet, uint32_t traceId = 0,
+                          const BroadcastHook& ordered = nullptr);
     void sendRecentMessages(uint16_t groupId, int socket);
 
     std::vector<uint16_t> listGroups() const;
 
+    // hot upgrade: (group, socket) of every member, cached history oldest
+    // first, and loading that history into a fresh process
+    std::vector<std::pair<uint16_t, int>> memberSockets() const;
+    std::map<uint16_t, std::vector<ChatPacket>> history() const;
+    void restoreHistory(uint16_t groupId, const std::vector<ChatPacket>& packets);
+
+    // lock-free: current directory snapshot
+    std::shared_ptr<const GroupDirectory> directory() const;
+
 private:
     mutable std::mutex mtx_;
-    std::map<uint16_t, std::vector<ClientInfo>> groups_;
-    std::map<uint16_t, CircularCache<ChatPacket>> caches_;
+    std::map<uint16_t, std::vector<ClientInfo>> groups_;     // non-empty groups only
+    // kept for rejoins; storage lives on the NUMA node of the thread that created the group
+    using GroupCache = CircularCache<ChatPacket, NumaAllocator<ChatPacket>>;
+    std::map<uint16_t, GroupCache> caches_;
+    std::map<uint16_t, std::shared_ptr<GroupActivity>> activity_;
     std::size_t cacheSize_;
+    std::shared_ptr<const GroupDirectory> directory_;        // std::atomic_load/store only
+    uint64_t directoryVersion_ = 0;
+
+    void publishDirectory();   // caller holds mtx_
+    bool joinLocked(uint16_t groupId, const ClientInfo& client);   // caller holds mtx_
 };
@@ -0,0 +1,275 @@
+// Server/hot_upgrade.cpp
+#include "hot_upgrade.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char     kMagic[4]      = {'G', 'C', 'U', 'P'};
+constexpr uint32_t kVersion       = 2;
+constexpr size_t   kConnsPerBatch = 64;            // fds per SCM_RIGHTS message
+constexpr size_t   kMaxMessage    = 64 * 1024;
+
+#pragma pack(push, 1)
+struct UpgradeHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t packetSize;
+    uint32_t nextConnId;
+    uint32_t numConns;
+    uint32_t numGroups;
+    uint8_t  hasTcp;
+    uint8_t  hasUnix;
+    char     unixPath[108];
+};
+
+struct ConnRecord {
+    uint32_t connId;
+    uint16_t currentGroup;
+    uint8_t  joined;
+    char     username[sizeof(ChatPacket::payload)];
+    uint16_t pendingLen;
+    char     pending[sizeof(ChatPacket)];
+};
+
+struct GroupRecord {
+    uint16_t groupId;
+    uint16_t count;         // ChatPackets that follow
+};
+#pragma pack(pop)
+
+bool sendMsg(int sock, const void* data, size_t len, const std::vector<int>& fds = {}) {
+    iovec iov{const_cast<void*>(data), len};
+    msghdr msg{};
+    msg.msg_iov    = &iov;
+    msg.msg_iovlen = 1;
+
+    std::vector<char> control;
+    if (!fds.empty()) {
+        control.resize(CMSG_SPACE(sizeof(int) * fds.size()));
+        msg.msg_control    = control.data();
+        msg.msg_controllen = control.size();
+        cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type  = SCM_RIGHTS;
+        cm->cmsg_len   = CMSG_LEN(sizeof(int) * fds.size());
+        std::memcpy(CMSG_DATA(cm), fds.data(), sizeof(int) * fds.size());
+    }
+
+    ssize_t n;
+    do {
+        n = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n == static_cast<ssize_t>(len);
+}
+
+// One SEQPACKET message; received fds are appended to `fds`. Returns the
+// payload length, or -1 on EOF / error.
+ssize_t recvMsg(int sock, std::vector<char>& buf, std::vector<int>& fds) {
+    buf.resize(kMaxMessage);
+    iovec iov{buf.data(), buf.size()};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * (kConnsPerBatch + 2))];
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+
+    for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) continue;
+        size_t count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const int* p = reinterpret_cast<const int*>(CMSG_DATA(cm));
+        fds.insert(fds.end(), p, p + count);
+    }
+    if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) return -1;
+    buf.resize(static_cast<size_t>(n));
+    return n;
+}
+
+sockaddr_un unixAddr(const std::string& path, bool& ok) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    ok = path.size() < sizeof(addr.sun_path);
+    if (ok) std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+void closeAll(const std::vector<int>& fds) {
+    for (int fd : fds) ::close(fd);
+}
+
+} // namespace
+
+int upgrade_listen(const std::string& path) {
+    bool ok;
+    sockaddr_un addr = unixAddr(path, ok);
+    if (!ok) return -1;
+
+    int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    ::unlink(path.c_str());
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 1) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool upgrade_read_request(int ctl) {
+    char req[sizeof(kMagic)];
+    ssize_t n = ::recv(ctl, req, sizeof(req), 0);
+    return n == sizeof(req) && std::memcmp(req, kMagic, sizeof(kMagic)) == 0;
+}
+
+bool upgrade_send_state(int ctl, const UpgradeState& state) {
+    UpgradeHeader hdr{};
+    std::memcpy(hdr.magic, kMagic, sizeof(kMagic));
+    hdr.version    = kVersion;
+    hdr.packetSize = sizeof(ChatPacket);
+    hdr.nextConnId = state.nextConnId;
+    hdr.numConns   = static_cast<uint32_t>(state.conns.size());
+    hdr.numGroups  = static_cast<uint32_t>(state.history.size());
+    hdr.hasTcp     = state.tcpListener >= 0;
+    hdr.hasUnix    = state.unixListener >= 0;
+    std::strncpy(hdr.unixPath, state.unixPath.c_str(), sizeof(hdr.unixPath) - 1);
+
+    std::vector<int> listeners;
+    if (hdr.hasTcp)  listeners.push_back(state.tcpListener);
+    if (hdr.hasUnix) listeners.push_back(state.unixListener);
+    if (!sendMsg(ctl, &hdr, sizeof(hdr), listeners)) return false;
+
+    for (size_t i = 0; i < state.conns.size(); i += kConnsPerBatch) {
+        size_t end = std::min(state.conns.size(), i + kConnsPerBatch);
+        std::vector<ConnRecord> recs(end - i);
+        std::vector<int> fds;
+        for (size_t j = i; j < end; ++j) {
+            const UpgradeConn& c = state.conns[j];
+            ConnRecord& r = recs[j - i];
+            r.connId       = c.connId;
+            r.currentGroup = c.currentGroup;
+            r.joined       = c.joined;
+            std::strncpy(r.username, c.username.c_str(), sizeof(r.username) - 1);
+            r.username[sizeof(r.username) - 1] = '\0';
+            if (c.pending.size() >= sizeof(r.pending)) return false;
+            r.pendingLen   = static_cast<uint16_t>(c.pending.size());
+            std::memcpy(r.pending, c.pending.data(), c.pending.size());
+            fds.push_back(c.fd);
+        }
+        if (!sendMsg(ctl, recs.data(), recs.size() * sizeof(ConnRecord), fds)) return false;
+    }
+
+    std::vector<char> buf;
+    for (const auto& kv : state.history) {
+        GroupRecord gr{kv.first, static_cast<uint16_t>(kv.second.size())};
+        buf.assign(reinterpret_cast<const char*>(&gr),
+                   reinterpret_cast<const char*>(&gr) + sizeof(gr));
+        buf.insert(buf.end(), reinterpret_cast<const char*>(kv.second.data()),
+                   reinterpret_cast<const char*>(kv.second.data() + kv.second.size()));
+        if (buf.size() > kMaxMessage) return false;
+        if (!sendMsg(ctl, buf.data(), buf.size())) return false;
+    }
+
+    return sendMsg(ctl, "DONE", 4);
+}
+
+bool upgrade_wait_ready(int ctl, int timeoutMs) {
+    pollfd pfd{ctl, POLLIN, 0};
+    if (::poll(&pfd, 1, timeoutMs) <= 0) return false;
+    char ack[5];
+    return ::recv(ctl, ack, sizeof(ack), 0) == 5 && std::memcmp(ack, "READY", 5) == 0;
+}
+
+int upgrade_take_over(const std::string& path, UpgradeState& state) {
+    bool ok;
+    sockaddr_un addr = unixAddr(path, ok);
+    if (!ok) return -1;
+
+    int ctl = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (ctl < 0) return -1;
+    if (::connect(ctl, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        !sendMsg(ctl, kMagic, sizeof(kMagic))) {
+        ::close(ctl);   // nothing running there: a normal cold start
+        return -1;
+    }
+
+    std::vector<char> buf;
+    std::vector<int> fds;
+    auto fail = [&]() -> int {
+        closeAll(fds);
+        ::close(ctl);   // the old process sees EOF and resumes
+        return -1;
+    };
+
+    if (recvMsg(ctl, buf, fds) != sizeof(UpgradeHeader)) return fail();
+    UpgradeHeader hdr;
+    std::memcpy(&hdr, buf.data(), sizeof(hdr));
+    if (std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) != 0 || hdr.version != kVersion ||
+        hdr.packetSize != sizeof(ChatPacket) ||
+        fds.size() != static_cast<size_t>(hdr.hasTcp + hdr.hasUnix)) {
+        return fail();
+    }
+
+    UpgradeState st;
+    size_t next = 0;
+    if (hdr.hasTcp)  st.tcpListener  = fds[next++];
+    if (hdr.hasUnix) st.unixListener = fds[next++];
+    hdr.unixPath[sizeof(hdr.unixPath) - 1] = '\0';
+    st.unixPath   = hdr.unixPath;
+    st.nextConnId = hdr.nextConnId;
+
+    while (st.conns.size() < hdr.numConns) {
+        ssize_t n = recvMsg(ctl, buf, fds);
+        size_t count = n > 0 ? static_cast<size_t>(n) / sizeof(ConnRecord) : 0;
+        if (n <= 0 || n % sizeof(ConnRecord) != 0 || fds.size() != next + count) return fail();
+        for (size_t i = 0; i < count; ++i) {
+            ConnRecord r;
+            std::memcpy(&r, buf.data() + i * sizeof(r), sizeof(r));
+            r.username[sizeof(r.username) - 1] = '\0';
+            if (r.pendingLen >= sizeof(r.pending)) return fail();
+            st.conns.push_back(UpgradeConn{fds[next++], r.connId, r.currentGroup,
+                                           r.joined != 0, r.username,
+                                           std::string(r.pending, r.pendingLen)});
+        }
+    }
+
+    for (uint32_t g = 0; g < hdr.numGroups; ++g) {
+        ssize_t n = recvMsg(ctl, buf, fds);
+        if (n < static_cast<ssize_t>(sizeof(GroupRecord))) return fail();
+        GroupRecord gr;
+        std::memcpy(&gr, buf.data(), sizeof(gr));
+        if (static_cast<size_t>(n) != sizeof(gr) + gr.count * sizeof(ChatPacket)) return fail();
+        auto& packets = st.history[gr.groupId];
+        packets.resize(gr.count);
+        std::memcpy(packets.data(), buf.data() + sizeof(gr), gr.count * sizeof(ChatPacket));
+    }
+
+    if (recvMsg(ctl, buf, fds) != 4 || std::memcmp(buf.data(), "DONE", 4) != 0) return fail();
+
+    state = std::move(st);
+    return ctl;
+}
+
+void upgrade_finish(int ctl) {
+    sendMsg(ctl, "READY", 5);
+    // the old process exits right after reading READY; its end closing is
+    // the signal that nobody else reads from the adopted sockets any more
+    char b;
+    while (true) {
+        ssize_t n = ::recv(ctl, &b, 1, 0);
+        if (n > 0 || (n < 0 && errno == EINTR)) continue;
+        break;
+    }
+    ::close(ctl);
+}
@@ -0,0 +1,64 @@
+// Server/hot_upgrade.h
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "../Shared/protocol.h"
+
+// Zero-downtime restart.
+//
+// A server started with --upgrade-socket <path> listens on that Unix
+// (SOCK_SEQPACKET) socket. A new binary started with the same option finds
+// the old process there and takes over:
+//
+//   new -> old   "GCUP" request
+//   old          parks its connection threads between reads and drains the
+//                ThreadPool
+//   old -> new   header + listening sockets          (SCM_RIGHTS)
+//   old -> new   connection records + their sockets  (SCM_RIGHTS, batches);
+//                a record carries any partly received packet, which the
+//                new process puts back in front of the socket's next bytes
+//   old -> new   one message per group history cache
+//   old -> new   "DONE"
+//   new -> old   "READY"; the old process exits, which the new one sees as
+//                EOF before it starts reading from the adopted sockets
+//
+// If anything fails before READY the old process un-parks and keeps serving.
+// Shared-memory and inter-node connections are not handed over; they are
+// closed with the old process and their peers reconnect.
+
+struct UpgradeConn {
+    int           fd = -1;
+    std::uint32_t connId = 0;
+    std::uint16_t currentGroup = 1;
+    bool          joined = false;      // member of currentGroup
+    std::string   username;
+    std::string   pending;             // start of a packet, < sizeof(ChatPacket) bytes
+};
+
+struct UpgradeState {
+    int           tcpListener  = -1;
+    int           unixListener = -1;
+    std::string   unixPath;
+    std::uint32_t nextConnId = 1;
+    std::vector<UpgradeConn> conns;
+    std::map<std::uint16_t, std::vector<ChatPacket>> history;   // oldest first
+};
+
+// Old side: control socket the next binary connects to; -1 on error.
+int upgrade_listen(const std::string& path);
+
+// Old side, on an accepted control connection: read the request, send
+// `state`, wait for READY. True once the new process has everything.
+bool upgrade_read_request(int ctl);
+bool upgrade_send_state(int ctl, const UpgradeState& state);
+bool upgrade_wait_ready(int ctl, int timeoutMs);
+
+// New side: take over from the server listening on `path`. Returns the
+// control socket, or -1 if nobody is listening there (or the handoff
+// failed, in which case the old server keeps running).
+int  upgrade_take_over(const std::string& path, UpgradeState& state);
+// Tell the old process to exit and wait until it has.
+void upgrade_finish(int ctl);
@@ -0,0 +1,236 @@
+// Server/msg_trace.cpp
+#include "msg_trace.h"
+#include "async_log.h"
+#include "../Shared/thread_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr std::size_t kRingSize   = 1024;      // spans per thread (~24 KiB)
+constexpr std::size_t kWindowSize = 1 << 16;   // most recent spans kept for export
+
+struct TraceSpan {
+    std::uint64_t startUs;
+    std::uint32_t durUs;
+    std::uint32_t traceId;
+    std::uint32_t threadId;
+    std::int32_t  sock;
+    std::uint16_t groupId;
+    TraceStage    stage;
+};
+
+// one ring per traced thread, drained by the collector
+ThreadRingSet<TraceSpan, kRingSize> g_rings;
+
+std::atomic<std::uint32_t> g_sampleEvery{0};
+std::atomic<std::uint32_t> g_sampleCount{0};   // messages seen while sampling, all threads
+std::atomic<std::uint32_t> g_nextTraceId{1};
+std::atomic<std::uint64_t> g_recorded{0};
+std::atomic<std::uint64_t> g_dropped{0};
+std::atomic<bool>          g_exportRequested{false};
+std::atomic<bool>          g_reloadRequested{false};
+
+std::atomic<bool> g_running{false};
+std::thread       g_collector;
+std::string       g_exportPath;
+std::string       g_ratePath;
+
+std::mutex             g_windowMutex;
+std::vector<TraceSpan> g_window;        // ring of kWindowSize once full
+std::size_t            g_windowNext = 0;
+
+const char* stageName(TraceStage stage) {
+    switch (stage) {
+        case TraceStage::Recv:      return "recv";
+        case TraceStage::Enqueue:   return "enqueue";
+        case TraceStage::QueueWait: return "queue_wait";
+        case TraceStage::CachePush: return "cache_push";
+        case TraceStage::Send:      return "send";
+    }
+    return "?";
+}
+
+// Moves queued spans into the export window, oldest overwritten first.
+void collect() {
+    std::lock_guard<std::mutex> lock(g_windowMutex);
+    g_rings.drain([](const TraceSpan& span) {
+        if (g_window.size() < kWindowSize) {
+            g_window.push_back(span);
+        } else {
+            g_window[g_windowNext] = span;
+            g_windowNext = (g_windowNext + 1) % kWindowSize;
+        }
+    });
+}
+
+// New sampling rate from the first number in g_ratePath.
+void reloadRate() {
+    std::FILE* in = g_ratePath.empty() ? nullptr : std::fopen(g_ratePath.c_str(), "r");
+    unsigned long every = 0;
+    bool ok = in && std::fscanf(in, "%lu", &every) == 1;
+    if (in) std::fclose(in);
+    if (!ok) {
+        log_warn("Cannot read a trace rate from %s", g_ratePath.c_str());
+        return;
+    }
+    trace_set_sample_every(static_cast<std::uint32_t>(every));
+    if (every) log_info("Tracing 1 in %lu messages", every);
+    else       log_info("Tracing off");
+}
+
+void collectLoop() {
+    while (g_running.load()) {
+        collect();
+        if (g_reloadRequested.exchange(false)) reloadRate();
+        if (g_exportRequested.exchange(false)) {
+            if (trace_export(g_exportPath)) {
+                log_info("Trace written to %s", g_exportPath.c_str());
+            } else {
+                log_warn("Cannot write trace to %s", g_exportPath.c_str());
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    collect();
+}
+
+} // namespace
+
+void trace_init(std::uint32_t sampleEvery, const std::string& exportPath,
+                const std::string& ratePath) {
+    if (g_running.load()) return;
+    g_exportPath = exportPath;
+    g_ratePath = ratePath;
+    g_sampleEvery.store(sampleEvery);
+    g_running.store(true);
+    g_collector = std::thread(collectLoop);
+}
+
+void trace_shutdown() {
+    if (!g_running.exchange(false)) return;
+    if (g_collector.joinable()) g_collector.join();
+}
+
+void trace_set_sample_every(std::uint32_t n) {
+    g_sampleEvery.store(n, std::memory_order_relaxed);
+}
+
+std::uint32_t trace_sample_every() {
+    return g_sampleEvery.load(std::memory_order_relaxed);
+}
+
+std::uint32_t trace_sample() {
+    std::uint32_t every = g_sampleEvery.load(std::memory_order_relaxed);
+    if (every == 0) return 0;
+
+    // one counter for the whole server: with a thread per connection a
+    // per-thread count would never trace a connection sending fewer than N
+    if (g_sampleCount.fetch_add(1, std::memory_order_relaxed) % every != 0) return 0;
+
+    std::uint32_t id = g_nextTraceId.fetch_add(1, std::memory_order_relaxed);
+    return id ? id : g_nextTraceId.fetch_add(1, std::memory_order_relaxed);   // 0 = untraced
+}
+
+std::uint64_t trace_now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+void trace_span(std::uint32_t traceId, TraceStage stage, std::uint64_t startUs,
+                std::uint64_t endUs, std::uint16_t groupId, int sock) {
+    auto& ring = g_rings.local();
+    TraceSpan* span = ring.claim();
+    if (!span) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    span->startUs  = startUs;
+    span->durUs    = static_cast<std::uint32_t>(endUs > startUs ? endUs - startUs : 0);
+    span->traceId  = traceId;
+    span->threadId = ring.threadId;
+    span->sock     = sock;
+    span->groupId  = groupId;
+    span->stage    = stage;
+
+    ring.publish();
+    g_recorded.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool trace_export(const std::string& path) {
+    std::vector<TraceSpan> spans;
+    {
+        std::lock_guard<std::mutex> lock(g_windowMutex);
+        spans = g_window;
+    }
+    std::sort(spans.begin(), spans.end(),
+              [](const TraceSpan& a, const TraceSpan& b) { return a.startUs < b.startUs; });
+
+    std::FILE* out = std::fopen(path.c_str(), "w");
+    if (!out) return false;
+
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const TraceSpan& s : spans) {
+        const char* sep = first ? "" : ",\n";
+        first = false;
+        unsigned long long ts = s.startUs;
+
+        if (s.stage == TraceStage::QueueWait) {
+            // async pair: a queued message belongs to no thread, and the wait
+            // overlaps whatever the worker was running before it
+            std::fprintf(out,
+                         "%s{\"name\":\"queue_wait\",\"cat\":\"msg\",\"ph\":\"b\",\"id\":%u,"
+                         "\"ts\":%llu,\"pid\":1,\"tid\":%u,\"args\":{\"group\":%u}},\n"
+                         "{\"name\":\"queue_wait\",\"cat\":\"msg\",\"ph\":\"e\",\"id\":%u,"
+                         "\"ts\":%llu,\"pid\":1,\"tid\":%u}",
+                         sep, s.traceId, ts, s.threadId, s.groupId, s.traceId,
+                         ts + s.durUs, s.threadId);
+            continue;
+        }
+
+        std::fprintf(out,
+                     "%s{\"name\":\"%s\",\"cat\":\"msg\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,"
+                     "\"pid\":1,\"tid\":%u,\"args\":{\"msg\":%u,\"group\":%u",
+                     sep, stageName(s.stage), ts, s.durUs, s.threadId, s.traceId, s.groupId);
+        if (s.sock >= 0) std::fprintf(out, ",\"sock\":%d", s.sock);
+        std::fprintf(out, "}}");
+
+        // flow arrow from the connection thread to the worker that ran the fan-out
+        if (s.stage == TraceStage::Enqueue || s.stage == TraceStage::CachePush) {
+            bool start = s.stage == TraceStage::Enqueue;
+            std::fprintf(out,
+                         ",\n{\"name\":\"msg\",\"cat\":\"msg\",\"ph\":\"%s\",%s\"id\":%u,"
+                         "\"ts\":%llu,\"pid\":1,\"tid\":%u}",
+                         start ? "s" : "f", start ? "" : "\"bp\":\"e\",", s.traceId, ts,
+                         s.threadId);
+        }
+    }
+    std::fprintf(out, "\n]}\n");
+    return std::fclose(out) == 0;
+}
+
+void trace_request_export() {
+    g_exportRequested.store(true);
+}
+
+void trace_request_rate_reload() {
+    g_reloadRequested.store(true);
+}
+
+std::uint64_t trace_spans_recorded() {
+    return g_recorded.load();
+}
+
+std::uint64_t trace_spans_dropped() {
+    return g_dropped.load();
+}
@@ -0,0 +1,55 @@
+// Server/msg_trace.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Sampled per-message tracing.
+//
+// One in every N MESSAGE packets the server reads, counted across all
+// connections, gets a trace id.
+// Each stage that message then passes through records a span (start,
+// duration, thread, group) into the calling thread's own single-producer
+// ring (Shared/thread_ring.h, shared with async_log): no locks and no
+// syscalls on the traced path. A collector thread moves spans into a bounded window of the
+// most recent ones, and trace_export() writes that window as Chrome trace
+// event JSON (chrome://tracing, Perfetto).
+//
+// Stages:  recv        packet read -> handed to the pool (decode, admission)
+//          enqueue     ThreadPool::enqueue
+//          queue_wait  waiting for a worker
+//          cache_push  copy into the group's history cache
+//          send        one per recipient (args.sock)
+//
+// With sampling off, trace_sample() is a single relaxed atomic load and
+// returns 0; callers skip every other trace call on traceId == 0.
+
+enum class TraceStage : std::uint8_t { Recv, Enqueue, QueueWait, CachePush, Send };
+
+// Starts the collector. kill -USR2 (or trace_request_export()) writes the
+// current window to exportPath; kill -HUP (trace_request_rate_reload())
+// sets the sampling rate to the number in ratePath.
+void trace_init(std::uint32_t sampleEvery, const std::string& exportPath,
+                const std::string& ratePath = "");
+void trace_shutdown();
+
+// Any time, from any thread. 0 = off, 1 = every message.
+void          trace_set_sample_every(std::uint32_t n);
+std::uint32_t trace_sample_every();
+
+// New trace id if this message is sampled, else 0.
+std::uint32_t trace_sample();
+
+std::uint64_t trace_now_us();
+void trace_span(std::uint32_t traceId, TraceStage stage, std::uint64_t startUs,
+                std::uint64_t endUs, std::uint16_t groupId, int sock = -1);
+
+// Writes the retained spans; false if the file can't be written.
+bool trace_export(const std::string& path);
+// Async-signal-safe: the collector exports on its next tick.
+void trace_request_export();
+// Async-signal-safe: the collector re-reads ratePath on its next tick.
+void trace_request_rate_reload();
+
+std::uint64_t trace_spans_recorded();
+std::uint64_t trace_spans_dropped();   // lost to full per-thread rings
@@ -1,8 +1,14 @@
 // Server/perf_stats.cpp
 #include "perf_stats.h"
+#include "buffer_pool.h"
+#include "async_log.h"
+#include "cpu_affinity.h"
+#include "msg_trace.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -25,9 +31,59 @@ static std::mutex g_cacheMutex;
 
 // ---- thread / queue stats ----
 static std::vector<std::uint64_t> g_tasksPerThread;
+static std::vector<int> g_threadCpu;                    // -1 = not pinned
+static constexpr int kMaxCpus = 256;
+static std::atomic<std::uint64_t> g_tasksPerCpu[kMaxCpus];
 static std::mutex g_tasksMutex;
 static std::atomic<std::uint64_t> g_maxQueueSize{0};
 
+// ---- per-lane queue wait ----
+struct LaneStats {
+    std::atomic<std::uint64_t> tasks{0};
+    std::atomic<std::uint64_t> totalWaitUs{0};
+    std::atomic<std::uint64_t> maxWaitUs{0};
+};
+static const char* const kLaneNames[] = {"Control", "Bulk"};
+static LaneStats g_lanes[2];
+
+// ---- adaptive pool sizing ----
+struct PoolResize {
+    double atSec;
+    std::size_t from, to;
+    const char* reason;
+};
+static constexpr std::size_t kMaxResizeEvents = 32;   // most recent kept
+static std::deque<PoolResize> g_poolResizes;
+static std::mutex g_poolMutex;
+static std::size_t g_poolSize = 0;
+static std::size_t g_poolPeak = 0;
+static std::uint64_t g_poolGrows = 0;
+static std::uint64_t g_poolShrinks = 0;
+
+// ---- admission control ----
+static std::atomic<std::uint64_t> g_throttledConn{0};
+static std::atomic<std::uint64_t> g_throttledGroup{0};
+static std::atomic<std::uint64_t> g_shed{0};
+
+// ---- connection liveness ----
+static std::atomic<std::uint64_t> g_heartbeatsSent{0};
+static std::atomic<std::uint64_t> g_reaped{0};
+
+
+// ---- cluster ----
+static std::atomic<std::uint64_t> g_clusterBatches{0};
+static std::atomic<std::uint64_t> g_clusterSent{0};
+static std::atomic<std::uint64_t> g_clusterMaxBatch{0};
+static std::atomic<std::uint64_t> g_clusterDropped{0};
+static std::atomic<std::uint64_t> g_clusterReceived{0};
+
+// ---- search ----
+static std::atomic<std::uint64_t> g_searches{0};
+static std::atomic<std::uint64_t> g_searchTotalUs{0};
+static std::atomic<std::uint64_t> g_searchMaxUs{0};
+static std::atomic<std::uint64_t> g_searchMatches{0};
+static std::atomic<std::size_t>   g_searchBytes{0};
+static std::atomic<std::size_t>   g_searchPeakBytes{0};
 
 // ---- virtual memory / paging simulation ----
 struct Page {
@@ -91,6 +147,16 @@ void stats_init() {
     g_startTime = Clock::now();
     g_messageCount.store(0);
     g_maxQueueSize.store(0);
+    for (auto& l : g_lanes) {
+        l.tasks.store(0);
+        l.totalWaitUs.store(0);
+        l.maxWaitUs.store(0);
+    }
+    g_throttledConn.store(0);
+    g_throttledGroup.store(0);
+    g_shed.store(0);
+    g_heartbeatsSent.store(0);
+    g_reaped.store(0);
 }
 
 
@@ -98,6 +164,7 @@ void stats_init_threads(std::size_t numThreads) {
     std::lock_guard<std::mutex> lock(g_tasksMutex);
     g_tasksPerThread.clear();
     g_tasksPerThread.resize(numThreads, 0);   // now OK: plain uint64_t
+    g_threadCpu.assign(numThreads, -1);
 }
 
 
@@ -133,6 +200,13 @@ void stats_record_task_completed(std::size_t threadIndex) {
     if (threadIndex < g_tasksPerThread.size()) {
         g_tasksPerThread[threadIndex]++;
     }
+    int cpu = current_cpu();
+    if (cpu >= 0 && cpu < kMaxCpus) g_tasksPerCpu[cpu]++;
+}
+
+void stats_set_thread_cpu(std::size_t threadIndex, int cpu) {
+    std::lock_guard<std::mutex> lock(g_tasksMutex);
+    if (threadIndex < g_threadCpu.size()) g_threadCpu[threadIndex] = cpu;
 }
 
 
@@ -144,6 +218,83 @@ void stats_record_queue_size(std::size_t queueSize) {
     }
 }
 
+void stats_record_queue_wait(std::size_t lane, std::uint64_t waitUs) {
+    if (lane >= 2) return;
+    LaneStats& l = g_lanes[lane];
+    l.tasks++;
+    l.totalWaitUs += waitUs;
+    std::uint64_t cur = l.maxWaitUs.load();
+    while (waitUs > cur && !l.maxWaitUs.compare_exchange_weak(cur, waitUs)) {
+        // CAS loop
+    }
+}
+
+void stats_record_pool_size(std::size_t from, std::size_t to, const char* reason) {
+    double atSec = std::chrono::duration<double>(Clock::now() - g_startTime).count();
+    std::lock_guard<std::mutex> lock(g_poolMutex);
+    g_poolSize = to;
+    g_poolPeak = std::max(g_poolPeak, to);
+    if (from == 0) return;   // initial size, not a resize
+    if (to > from) g_poolGrows++; else g_poolShrinks++;
+    g_poolResizes.push_back(PoolResize{atSec, from, to, reason});
+    if (g_poolResizes.size() > kMaxResizeEvents) g_poolResizes.pop_front();
+}
+
+void stats_record_throttled_conn() {
+    g_throttledConn++;
+}
+
+void stats_record_throttled_group() {
+    g_throttledGroup++;
+}
+
+void stats_record_shed() {
+    g_shed++;
+}
+
+void stats_record_heartbeat_sent() {
+    g_heartbeatsSent++;
+}
+
+void stats_record_reaped() {
+    g_reaped++;
+}
+
+void stats_record_search(std::uint64_t latencyUs, std::size_t matches) {
+    g_searches++;
+    g_searchTotalUs += latencyUs;
+    g_searchMatches += matches;
+    std::uint64_t cur = g_searchMaxUs.load();
+    while (latencyUs > cur && !g_searchMaxUs.compare_exchange_weak(cur, latencyUs)) {
+        // CAS loop
+    }
+}
+
+void stats_set_search_memory(std::size_t bytes) {
+    g_searchBytes = bytes;
+    std::size_t cur = g_searchPeakBytes.load();
+    while (bytes > cur && !g_searchPeakBytes.compare_exchange_weak(cur, bytes)) {
+        // CAS loop
+    }
+}
+
+void stats_record_cluster_batch(std::size_t packets) {
+    g_clusterBatches++;
+    g_clusterSent += packets;
+    std::uint64_t cur = g_clusterMaxBatch.load();
+    while (packets > cur && !g_clusterMaxBatch.compare_exchange_weak(cur, packets)) {
+        // CAS loop
+    }
+}
+
+void stats_record_cluster_dropped(std::size_t packets) {
+    g_clusterDropped += packets;
+}
+
+void stats_record_cluster_received() {
+    g_clusterReceived++;
+}
+
 void stats_vm_access(int pageId) {
     g_vm.access(pageId);
 }
@@ -171,18 +322,95 @@ static void dumpToStream(std::ostream& os) {
     std::lock_guard<std::mutex> lock(g_tasksMutex);
     for (std::size_t i = 0; i < g_tasksPerThread.size(); ++i) {
         os << "Thread " << i << " completed "
-           << g_tasksPerThread[i] << " tasks\n";
+           << g_tasksPerThread[i] << " tasks";
+        if (g_threadCpu[i] >= 0) os << " (pinned to cpu " << g_threadCpu[i] << ")";
+        os << "\n";
     }
 }
+    for (int cpu = 0; cpu < kMaxCpus; ++cpu) {
+        std::uint64_t n = g_tasksPerCpu[cpu].load();
+        if (n == 0) continue;
+        os << "Core " << cpu << " (node " << numa_node_of_cpu(cpu) << ") ran "
+           << n << " tasks\n";
+    }
 
     os << "Max queue size: " << g_maxQueueSize.load() << "\n\n";
 
+    os << "--- Queue wait (per lane) ---\n";
+    for (std::size_t i = 0; i < 2; ++i) {
+        std::uint64_t n = g_lanes[i].tasks.load();
+        double avg = n ? static_cast<double>(g_lanes[i].totalWaitUs.load()) / n : 0.0;
+        os << kLaneNames[i] << "  tasks=" << n
+           << "  avg wait=" << avg << " us"
+           << "  max wait=" << g_lanes[i].maxWaitUs.load() << " us\n";
+    }
+    os << "\n";
+
+    os << "--- Pool sizing ---\n";
+    {
+        std::lock_guard<std::mutex> lock(g_poolMutex);
+        os << "Workers: current=" << g_poolSize << "  peak=" << g_poolPeak
+           << "  grows=" << g_poolGrows << "  shrinks=" << g_poolShrinks << "\n";
+        for (const auto& e : g_poolResizes) {
+            os << "  t=" << e.atSec << "s  " << e.from << " -> " << e.to
+               << "  (" << e.reason << ")\n";
+        }
+    }
+    os << "\n";
+
+    os << "--- Admission control ---\n";
+    os << "Throttled (connection): " << g_throttledConn.load() << "\n";
+    os << "Throttled (group): " << g_throttledGroup.load() << "\n";
+    os << "Shed (overload): " << g_shed.load() << "\n\n";
+
+    os << "--- Connections ---\n";
+    os << "Heartbeats sent: " << g_heartbeatsSent.load() << "\n";
+    os << "Reaped (idle): " << g_reaped.load() << "\n\n";
+
+    os << "--- Cluster ---\n";
+    {
+        std::uint64_t batches = g_clusterBatches.load();
+        std::uint64_t sent = g_clusterSent.load();
+        os << "Packets sent to nodes: " << sent << "  in " << batches << " batches"
+           << "  (avg " << (batches ? static_cast<double>(sent) / batches : 0.0)
+           << ", max " << g_clusterMaxBatch.load() << ")\n";
+        os << "Packets from nodes: " << g_clusterReceived.load() << "\n";
+        os << "Dropped (link down / full): " << g_clusterDropped.load() << "\n\n";
+    }
+
+    os << "--- Search ---\n";
+    {
+        std::uint64_t queries = g_searches.load();
+        os << "Queries: " << queries << "  avg latency "
+           << (queries ? static_cast<double>(g_searchTotalUs.load()) / queries : 0.0)
+           << " us, max " << g_searchMaxUs.load() << " us, avg matches "
+           << (queries ? static_cast<double>(g_searchMatches.load()) / queries : 0.0) << "\n";
+        os << "Index memory: " << g_searchBytes.load() << " bytes (peak "
+           << g_searchPeakBytes.load() << ")\n\n";
+    }
+
+    os << "--- Allocation ---\n";
+    message_pool().dump(os);
+    session_pool().dump(os);
+    os << "\n";
+
+    os << "--- Logging ---\n";
+    os << "Log records dropped: " << log_dropped() << "\n\n";
+
+    os << "--- Tracing ---\n";
+    std::uint32_t every = trace_sample_every();
+    if (every) os << "Sampling 1 in " << every << " messages\n";
+    else       os << "Sampling off\n";
+    os << "Spans recorded: " << trace_spans_recorded()
+       << ", dropped: " << trace_spans_dropped() << "\n\n";
+
     os << "--- Virtual Memory (simulated) ---\n";
     os << "Page faults: " << g_vm.getPageFaults() << "\n";
 }
 
 void stats_dump_to_stdout() {
     dumpToStream(std::cout);
+    std::cout.flush();   // the SIGINT path _Exit()s without flushing stdio
 }
 
 void stats_dump_to_file(const std::string& path) {
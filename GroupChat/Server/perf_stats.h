@@ -19,8 +19,29 @@ void stats_record_cache_hit(std::uint16_t groupId);
 void stats_record_cache_miss(std::uint16_t groupId);
 
 // ---- Thread / queue stats ----
-void stats_record_task_completed(std::size_t threadIndex);
+void stats_record_task_completed(std::size_t threadIndex);   // also counted per core
+void stats_set_thread_cpu(std::size_t threadIndex, int cpu);   // worker was pinned
 void stats_record_queue_size(std::size_t queueSize);
+void stats_record_queue_wait(std::size_t lane, std::uint64_t waitUs);  // 0 = control, 1 = bulk
+void stats_record_pool_size(std::size_t from, std::size_t to, const char* reason);  // ThreadPool resized
+
+// ---- Admission control ----
+void stats_record_throttled_conn();   // MESSAGE dropped by a per-connection limit
+void stats_record_throttled_group();  // MESSAGE dropped by a per-group limit
+void stats_record_shed();             // MESSAGE dropped because the server is overloaded
+
+// ---- Connection liveness ----
+void stats_record_heartbeat_sent();   // HEARTBEAT ping sent to an idle connection
+void stats_record_reaped();           // idle / half-open connection shut down
+
+// ---- Cluster ----
+void stats_record_cluster_batch(std::size_t packets);     // one send() on an inter-node link
+void stats_record_cluster_dropped(std::size_t packets);   // link down / buffer full
+void stats_record_cluster_received();                     // packet from another node
+
+// ---- Search ----
+void stats_record_search(std::uint64_t latencyUs, std::size_t matches);
+void stats_set_search_memory(std::size_t bytes);          // whole index, approximate
 
 // ---- Virtual memory (paging simulation) ----
 void stats_vm_access(int pageId);   // simulate referencing a "page"
@@ -0,0 +1,30 @@
+// Server/rate_limiter.cpp
+#include "rate_limiter.h"
+
+#include <algorithm>
+
+TokenBucket::TokenBucket(double rate, double burst)
+    : rate_(rate), burst_(burst), tokens_(burst), last_(Clock::now()) {}
+
+bool TokenBucket::tryConsume(Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - last_).count();
+    if (elapsed > 0.0) {
+        tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+        last_ = now;
+    }
+    if (tokens_ < 1.0) return false;
+    tokens_ -= 1.0;
+    return true;
+}
+
+GroupRateLimiter::GroupRateLimiter(double rate, double burst)
+    : rate_(rate), burst_(burst) {}
+
+bool GroupRateLimiter::tryConsume(std::uint16_t groupId) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = buckets_.find(groupId);
+    if (it == buckets_.end()) {
+        it = buckets_.emplace(groupId, TokenBucket(rate_, burst_)).first;
+    }
+    return it->second.tryConsume();
+}
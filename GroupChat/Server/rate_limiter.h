@@ -0,0 +1,48 @@
+// Server/rate_limiter.h
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+// Limits applied to MESSAGE packets before they reach the broadcast queue.
+struct AdmissionConfig {
+    double      connRate       = 50.0;    // msgs/sec per connection
+    double      connBurst      = 100.0;
+    double      groupRate      = 500.0;   // msgs/sec per group (all senders)
+    double      groupBurst     = 1000.0;
+    std::size_t maxInFlight    = 10000;   // broadcasts queued or running
+    std::size_t shedQueueDepth = 5000;    // ThreadPool queue depth that triggers shedding
+};
+
+// Classic token bucket: refills at `rate` tokens/sec up to `burst`.
+// Not thread-safe; each connection owns its own bucket.
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket(double rate, double burst);
+
+    bool tryConsume(Clock::time_point now = Clock::now());
+
+private:
+    double rate_;
+    double burst_;
+    double tokens_;
+    Clock::time_point last_;
+};
+
+// One bucket per group, shared by every connection sending to it.
+class GroupRateLimiter {
+public:
+    GroupRateLimiter(double rate, double burst);
+
+    bool tryConsume(std::uint16_t groupId);
+
+private:
+    std::mutex mtx_;
+    std::map<std::uint16_t, TokenBucket> buckets_;
+    double rate_;
+    double burst_;
+};
@@ -0,0 +1,267 @@
+// Server/search_index.cpp
+#include "search_index.h"
+#include "perf_stats.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <iterator>
+
+namespace {
+
+constexpr std::size_t kMinToken = 2;
+constexpr std::size_t kMaxToken = 32;
+// a payload holds at most 256 / 3 tokens of kMinToken letters and a separator
+constexpr std::size_t kMaxTokens = sizeof(ChatPacket{}.payload) / (kMinToken + 1) + 1;
+constexpr std::size_t kPendingReserve = 1024;
+constexpr auto kIndexInterval = std::chrono::milliseconds(20);
+
+// rough cost of a hash-map entry and a deque slot beyond their payload bytes
+constexpr std::size_t kTermOverhead = 64;
+constexpr std::size_t kDocOverhead  = sizeof(std::string) + 8;
+
+void putVarint(std::string& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+uint32_t getVarint(const std::string& in, std::size_t& pos) {
+    uint32_t v = 0;
+    for (int shift = 0; pos < in.size(); shift += 7) {
+        auto b = static_cast<unsigned char>(in[pos++]);
+        v |= static_cast<uint32_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+    }
+    return v;
+}
+
+struct Token {
+    char        text[kMaxToken + 1];
+    std::size_t len;
+};
+
+bool operator<(const Token& a, const Token& b) { return std::strcmp(a.text, b.text) < 0; }
+bool operator==(const Token& a, const Token& b) { return std::strcmp(a.text, b.text) == 0; }
+
+// Splits text into sorted, distinct tokens in out[0..max) without allocating;
+// returns how many there are. Tokens past `max` are dropped.
+std::size_t scanTokens(const char* text, Token* out, std::size_t max) {
+    std::size_t n = 0;
+    std::size_t len = 0;
+    for (const char* p = text;; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c && std::isalnum(c)) {
+            if (n < max && len < kMaxToken) out[n].text[len++] = static_cast<char>(std::tolower(c));
+            continue;
+        }
+        if (n < max && len >= kMinToken) {
+            out[n].text[len] = '\0';
+            out[n].len = len;
+            ++n;
+        }
+        len = 0;
+        if (!c) break;
+    }
+    std::sort(out, out + n);
+    return static_cast<std::size_t>(std::unique(out, out + n) - out);
+}
+
+} // namespace
+
+SearchIndex::SearchIndex(std::size_t maxBytesPerGroup)
+    : maxBytesPerGroup_(maxBytesPerGroup) {
+    pending_.reserve(kPendingReserve);
+    batch_.reserve(kPendingReserve);
+    term_.reserve(kMaxToken);
+    indexer_ = std::thread(&SearchIndex::indexLoop, this);
+}
+
+SearchIndex::~SearchIndex() {
+    running_.store(false);
+    if (indexer_.joinable()) indexer_.join();
+}
+
+std::vector<std::string> SearchIndex::tokenize(const char* text) {
+    Token buf[kMaxTokens];
+    std::size_t n = scanTokens(text, buf, kMaxTokens);
+    std::vector<std::string> tokens;
+    tokens.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) tokens.emplace_back(buf[i].text, buf[i].len);
+    return tokens;
+}
+
+SearchIndex::GroupIndex* SearchIndex::find(uint16_t groupId) const {
+    std::lock_guard<std::mutex> lock(mapMtx_);
+    auto it = groups_.find(groupId);
+    return it == groups_.end() ? nullptr : it->second.get();
+}
+
+void SearchIndex::add(uint16_t groupId, const ChatPacket& pkt) {
+    std::lock_guard<std::mutex> lock(pendingMtx_);
+    pending_.push_back(Pending{groupId, pkt});
+}
+
+void SearchIndex::indexLoop() {
+    while (running_.load()) {
+        drain();
+        std::this_thread::sleep_for(kIndexInterval);
+    }
+    drain();   // final pass after shutdown was requested
+}
+
+void SearchIndex::drain() {
+    std::lock_guard<std::mutex> lock(drainMtx_);
+    {
+        std::lock_guard<std::mutex> pendingLock(pendingMtx_);
+        batch_.swap(pending_);
+    }
+    for (const Pending& p : batch_) index(p.groupId, p.pkt);
+    batch_.clear();
+}
+
+void SearchIndex::index(uint16_t groupId, const ChatPacket& pkt) {
+    char text[sizeof(pkt.payload) + 1];
+    std::memcpy(text, pkt.payload, sizeof(pkt.payload));
+    text[sizeof(pkt.payload)] = '\0';
+    Token tokens[kMaxTokens];
+    std::size_t count = scanTokens(text, tokens, kMaxTokens);
+    if (count == 0) return;
+
+    GroupIndex* g;
+    {
+        std::lock_guard<std::mutex> lock(mapMtx_);
+        auto& slot = groups_[groupId];
+        if (!slot) slot = std::make_unique<GroupIndex>();
+        g = slot.get();   // never erased, so safe to use after unlocking
+    }
+
+    std::lock_guard<std::mutex> lock(g->mtx);
+    uint32_t id = g->firstId + static_cast<uint32_t>(g->docs.size());
+    g->docs.push_back(Doc{ntohl(pkt.timestamp), text});
+    std::size_t before = g->bytes;
+    g->bytes += kDocOverhead + g->docs.back().text.size();
+
+    for (std::size_t i = 0; i < count; ++i) {
+        term_.assign(tokens[i].text, tokens[i].len);
+        auto res = g->terms.try_emplace(term_);
+        Postings& p = res.first->second;
+        if (res.second) g->bytes += kTermOverhead + term_.size();
+        std::size_t size = p.bytes.size();
+        putVarint(p.bytes, id - p.last);
+        p.last = id;
+        p.count++;
+        g->bytes += p.bytes.size() - size;
+    }
+
+    while (g->bytes > maxBytesPerGroup_ && !g->docs.empty()) evictOldest(*g);
+
+    if (g->bytes >= before) totalBytes_ += g->bytes - before;
+    else                    totalBytes_ -= before - g->bytes;
+    stats_set_search_memory(totalBytes_.load());
+}
+
+// Drops the oldest quarter of the messages, then rewrites every posting
+// list without them. Lists are delta-coded from 0, so the first surviving
+// id is re-encoded and the rest of the bytes are copied as they are.
+void SearchIndex::evictOldest(GroupIndex& g) {
+    std::size_t drop = std::max<std::size_t>(1, g.docs.size() / 4);
+    for (std::size_t i = 0; i < drop; ++i) {
+        g.bytes -= kDocOverhead + g.docs.front().text.size();
+        g.docs.pop_front();
+    }
+    g.firstId += static_cast<uint32_t>(drop);
+
+    for (auto it = g.terms.begin(); it != g.terms.end();) {
+        Postings& p = it->second;
+        if (p.last < g.firstId) {
+            g.bytes -= kTermOverhead + it->first.size() + p.bytes.size();
+            it = g.terms.erase(it);
+            continue;
+        }
+
+        std::size_t pos = 0;
+        uint32_t id = 0;
+        uint32_t skipped = 0;
+        while (pos < p.bytes.size()) {
+            id += getVarint(p.bytes, pos);
+            if (id >= g.firstId) break;
+            ++skipped;
+        }
+        if (skipped) {
+            std::string trimmed;
+            putVarint(trimmed, id);
+            trimmed.append(p.bytes, pos, std::string::npos);
+            g.bytes -= p.bytes.size() - trimmed.size();
+            p.bytes.swap(trimmed);
+            p.bytes.shrink_to_fit();
+            p.count -= skipped;
+        }
+        ++it;
+    }
+}
+
+std::vector<uint32_t> SearchIndex::decode(const Postings& p, uint32_t minId) {
+    std::vector<uint32_t> ids;
+    ids.reserve(p.count);
+    std::size_t pos = 0;
+    uint32_t id = 0;
+    while (pos < p.bytes.size()) {
+        id += getVarint(p.bytes, pos);
+        if (id >= minId) ids.push_back(id);
+    }
+    return ids;
+}
+
+std::vector<ChatPacket> SearchIndex::query(uint16_t groupId, const std::string& text,
+                                           std::size_t limit, std::size_t& total) {
+    drain();   // index anything added before this search
+    total = 0;
+    std::vector<ChatPacket> out;
+    std::vector<std::string> tokens = tokenize(text.c_str());
+    GroupIndex* g = find(groupId);
+    if (tokens.empty() || !g) return out;
+
+    std::lock_guard<std::mutex> lock(g->mtx);
+
+    // rarest term first keeps every intersection small
+    std::vector<const Postings*> lists;
+    for (const std::string& t : tokens) {
+        auto it = g->terms.find(t);
+        if (it == g->terms.end()) return out;
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const Postings* a, const Postings* b) { return a->count < b->count; });
+
+    std::vector<uint32_t> hits = decode(*lists[0], g->firstId);
+    std::vector<uint32_t> next, merged;
+    for (std::size_t i = 1; i < lists.size() && !hits.empty(); ++i) {
+        next = decode(*lists[i], g->firstId);
+        merged.clear();
+        std::set_intersection(hits.begin(), hits.end(), next.begin(), next.end(),
+                              std::back_inserter(merged));
+        hits.swap(merged);
+    }
+
+    total = hits.size();
+    for (auto it = hits.rbegin(); it != hits.rend() && out.size() < limit; ++it) {
+        const Doc& d = g->docs[*it - g->firstId];
+        ChatPacket pkt{};
+        pkt.type      = ChatType::SEARCH;
+        pkt.groupID   = htons(groupId);
+        pkt.timestamp = htonl(d.timestamp);
+        std::snprintf(pkt.payload, sizeof(pkt.payload), "%s", d.text.c_str());
+        out.push_back(pkt);
+    }
+    return out;
+}
+
+std::size_t SearchIndex::memoryBytes() const {
+    return totalBytes_.load();
+}
@@ -0,0 +1,100 @@
+// Server/search_index.h
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../Shared/protocol.h"
+
+// Full-text index over group history.
+//
+// Every broadcast MESSAGE is tokenized (ASCII letters and digits, lowercased,
+// 2..32 chars) and appended to its group's inverted index under a per-group
+// message id. Ids only grow, so each term's posting list is kept as varint
+// deltas and adding a message appends a few bytes per distinct term.
+//
+// Each group has a memory budget (message text plus postings plus a fixed
+// per-entry overhead). Past it, the oldest quarter of the group's messages
+// is dropped and every posting list is trimmed of ids older than the first
+// message left, so old history ages out in bulk rather than per message.
+//
+// A query matches messages containing every query term and returns the
+// newest first. Groups are locked independently.
+//
+// add() runs on the fan-out path, so it only copies the packet onto a
+// pending list; an indexer thread tokenizes and indexes the list every
+// 20 ms, and query() indexes whatever is still pending before it looks,
+// so a search always sees every message added before it.
+
+class SearchIndex {
+public:
+    explicit SearchIndex(std::size_t maxBytesPerGroup = 1 << 20);
+    ~SearchIndex();
+
+    SearchIndex(const SearchIndex&) = delete;
+    SearchIndex& operator=(const SearchIndex&) = delete;
+
+    // pkt as broadcast: network byte order, payload is the message text
+    void add(uint16_t groupId, const ChatPacket& pkt);
+
+    // Up to `limit` matches, newest first, as SEARCH packets ready to send
+    // (timestamp of the original message). `total` gets the match count.
+    std::vector<ChatPacket> query(uint16_t groupId, const std::string& text,
+                                  std::size_t limit, std::size_t& total);
+
+    std::size_t memoryBytes() const;    // all groups, approximate
+
+    static std::vector<std::string> tokenize(const char* text);
+
+private:
+    struct Doc {
+        uint32_t    timestamp;   // host order
+        std::string text;
+    };
+
+    struct Postings {
+        std::string   bytes;     // varint deltas, the first one from 0
+        uint32_t      last  = 0; // newest id in the list
+        uint32_t      count = 0;
+    };
+
+    struct Pending {
+        uint16_t   groupId;
+        ChatPacket pkt;
+    };
+
+    struct GroupIndex {
+        mutable std::mutex mtx;
+        std::deque<Doc> docs;                              // docs[i] has id firstId + i
+        uint32_t firstId = 0;
+        std::unordered_map<std::string, Postings> terms;
+        std::size_t bytes = 0;                             // this group's share of memoryBytes()
+    };
+
+    std::size_t maxBytesPerGroup_;
+    mutable std::mutex mapMtx_;                            // guards groups_ only
+    std::map<uint16_t, std::unique_ptr<GroupIndex>> groups_;
+    std::atomic<std::size_t> totalBytes_{0};
+
+    std::mutex pendingMtx_;                                // guards pending_ only
+    std::vector<Pending> pending_;                         // swapped with batch_, so both keep capacity
+    std::mutex drainMtx_;                                  // one drain at a time, in add() order
+    std::vector<Pending> batch_;                           // under drainMtx_
+    std::string term_;                                     // under drainMtx_, lookup scratch
+    std::atomic<bool> running_{true};
+    std::thread indexer_;
+
+    void indexLoop();
+    void drain();
+    void index(uint16_t groupId, const ChatPacket& pkt);  // caller holds drainMtx_
+    GroupIndex* find(uint16_t groupId) const;
+    void evictOldest(GroupIndex& g);                       // caller holds g.mtx
+    static std::vector<uint32_t> decode(const Postings& p, uint32_t minId);
+};
@@ -1,13 +1,108 @@
 #include "chat_server.h"
+#include "traffic_capture.h"
+#include "async_log.h"
+#include "msg_trace.h"
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
+// usage: chat_server [port] [--capture <file>]
+//                    [--heartbeat <ms>] [--idle-timeout <ms>]
+//                    [--unix <path>] [--conn-rate <msg/s>] [--group-rate <msg/s>]
+//                    [--worker-cpus <list>] [--io-cpus <list>]
+//                    [--workers <n>|<min>-<max>] [--control-weight <n>]
+//                    [--node-id <n> --peer <id>=<host>:<port> ...]
+//                    [--upgrade-socket <path>]
+//                    [--trace <N>]   trace 1 in N messages; kill -USR2 writes logs/trace.json,
+//                                    kill -HUP reads a new N from logs/trace.rate
+//
+// CPU lists look like "0-3,8" or "node:1" (all CPUs of a NUMA node).
 int main(int argc, char* argv[]) {
     int port = 8080;
-    if (argc > 1) {
-        port = std::stoi(argv[1]);
+    std::string capturePath;
+    LivenessConfig liveness;
+    AdmissionConfig admission;
+    std::string unixPath;
+    AffinityConfig affinity;
+    PoolSizing workers;
+    ClusterConfig cluster;
+    std::string upgradePath;
+    std::uint32_t traceEvery = 0;
+    unsigned controlWeight = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--capture" && i + 1 < argc) {
+            capturePath = argv[++i];
+        } else if (arg == "--heartbeat" && i + 1 < argc) {
+            liveness.heartbeatMs = std::stoi(argv[++i]);
+        } else if (arg == "--idle-timeout" && i + 1 < argc) {
+            liveness.idleTimeoutMs = std::stoi(argv[++i]);
+        } else if (arg == "--unix" && i + 1 < argc) {
+            unixPath = argv[++i];
+        } else if (arg == "--conn-rate" && i + 1 < argc) {
+            admission.connRate  = std::stod(argv[++i]);
+            admission.connBurst = 2 * admission.connRate;
+        } else if (arg == "--group-rate" && i + 1 < argc) {
+            admission.groupRate  = std::stod(argv[++i]);
+            admission.groupBurst = 2 * admission.groupRate;
+        } else if ((arg == "--worker-cpus" || arg == "--io-cpus") && i + 1 < argc) {
+            std::vector<int> cpus = parse_cpu_list(argv[++i]);
+            if (cpus.empty()) {
+                std::cerr << "Invalid CPU list for " << arg << ": " << argv[i] << "\n";
+                return 1;
+            }
+            (arg == "--worker-cpus" ? affinity.workerCpus : affinity.ioCpus) = cpus;
+        } else if (arg == "--workers" && i + 1 < argc) {
+            // "8" = fixed size, "2-16" = adaptive between the bounds
+            std::string v = argv[++i];
+            std::size_t dash = v.find('-');
+            workers.minThreads = std::stoul(v.substr(0, dash));
+            workers.maxThreads = dash == std::string::npos ? workers.minThreads
+                                                           : std::stoul(v.substr(dash + 1));
+        } else if (arg == "--control-weight" && i + 1 < argc) {
+            controlWeight = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--node-id" && i + 1 < argc) {
+            cluster.nodeId = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--peer" && i + 1 < argc) {
+            PeerNode peer;
+            if (!Cluster::parsePeer(argv[++i], peer)) {
+                std::cerr << "Invalid peer (want <id>=<host>:<port>): " << argv[i] << "\n";
+                return 1;
+            }
+            cluster.peers.push_back(peer);
+        } else if (arg == "--upgrade-socket" && i + 1 < argc) {
+            upgradePath = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            traceEvery = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+        } else {
+            port = std::stoi(arg);
+        }
     }
 
-    ChatServer server(port, 4);
+    log_init("logs/server.log");
+    trace_init(traceEvery, "logs/trace.json", "logs/trace.rate");
+
+    if (!capturePath.empty()) {
+        if (!capture_open(capturePath)) {
+            log_error("Failed to open capture file %s", capturePath.c_str());
+            log_shutdown();
+            return 1;
+        }
+        log_info("Recording inbound packets to %s", capturePath.c_str());
+    }
+
+    ChatServer server(port, workers, admission, liveness, affinity, controlWeight);
+    if (!unixPath.empty()) server.listenUnix(unixPath);
+    if (!upgradePath.empty()) server.enableHotUpgrade(upgradePath);
+    if (!cluster.peers.empty()) {
+        log_info("Cluster node %u with %zu peers", cluster.nodeId, cluster.peers.size());
+        server.enableCluster(cluster);
+    }
     server.run();
-    return 0;
+    trace_shutdown();
+    log_shutdown();
+    // connection threads are detached and may still sit in recv(); don't run
+    // static destructors underneath them
+    std::_Exit(0);
 }
@@ -4,14 +4,29 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <csignal>
+#include <arpa/inet.h>
+#include <pthread.h>
 
 #include "thread_pool.h"
 #include "group_manager.h"     // your group management
 #include "../Shared/protocol.h"
 #include "../Shared/utils.h"
+#include "async_log.h"
+#include "perf_stats.h"
 
 GroupManager g_groups;         // global group manager (thread-safe inside)
 
+static std::atomic<bool> g_stop{false};
+
+// async-signal-safe: main() sees accept() fail with EINTR and shuts down
+static void handle_sigint(int) {
+    g_stop.store(true);
+}
+
 // Handle a single client: stay in a loop processing ChatPackets
 void handle_client(int client_socket) {
     std::string username = "anonymous";
@@ -20,7 +35,7 @@ void handle_client(int client_socket) {
     while (true) {
         ChatPacket pkt{};
         if (!recv_all(client_socket, &pkt, sizeof(pkt))) {
-            std::cout << "Client disconnected.\n";
+            log_info("Client disconnected.");
             if (currentGroup != 0) {
                 g_groups.leaveGroup(currentGroup, client_socket);
             }
@@ -37,8 +52,8 @@ void handle_client(int client_socket) {
                 username     = std::string(pkt.payload);
                 currentGroup = groupId;
 
-                std::cout << "Client joined group " << currentGroup
-                          << " as '" << username << "'\n";
+                log_info("Client joined group %u as '%s'",
+                         currentGroup, username.c_str());
 
                 g_groups.joinGroup(currentGroup,
                                    ClientInfo{client_socket, username});
@@ -55,7 +70,7 @@ void handle_client(int client_socket) {
             }
 
             case ChatType::LEAVE: {
-                std::cout << "Client leaving group " << groupId << "\n";
+                log_info("Client leaving group %u", groupId);
                 g_groups.leaveGroup(groupId, client_socket);
                 close(client_socket);
                 return; // end loop, close connection
@@ -83,15 +98,29 @@ void handle_client(int client_socket) {
 }
 
 int main() {
+    // only the accept loop takes SIGINT; every thread started below inherits
+    // the blocked mask
+    sigset_t intMask;
+    sigemptyset(&intMask);
+    sigaddset(&intMask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &intMask, nullptr);
+
+    log_init("logs/server.log");
     stats_init();
     stats_init_vm(32);
-    signal(SIGINT, handle_sigint);
+
+    // no SA_RESTART, so a blocked accept() returns EINTR
+    struct sigaction sa{};
+    sa.sa_handler = handle_sigint;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
     int server_fd, new_socket;
     struct sockaddr_in address{};
     int addrlen = sizeof(address);
 
     if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-        perror("socket failed");
+        log_error("socket failed: %s", std::strerror(errno));
+        log_shutdown();
         exit(EXIT_FAILURE);
     }
 
@@ -100,28 +129,45 @@ int main() {
     address.sin_port        = htons(8080);
 
     if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
-        perror("bind failed");
+        log_error("bind failed: %s", std::strerror(errno));
+        log_shutdown();
         exit(EXIT_FAILURE);
     }
     if (listen(server_fd, 16) < 0) {
-        perror("listen failed");
+        log_error("listen failed: %s", std::strerror(errno));
+        log_shutdown();
         exit(EXIT_FAILURE);
     }
 
-    ThreadPool pool(4);
-
-    std::cout << "Chat server listening on port 8080..." << std::endl;
-    while ((new_socket = accept(server_fd, (struct sockaddr *)&address,
-                                (socklen_t *)&addrlen)) >= 0) {
-        std::cout << "New connection accepted" << std::endl;
+    // each task is a whole connection, so grow on queue wait instead of
+    // leaving the fifth client waiting for one of four threads to free up
+    PoolSizing sizing;
+    sizing.minThreads = 4;
+    sizing.maxThreads = 64;
+    sizing.growQueueDepth = 1;
+    sizing.growSamples = 1;
+    sizing.cooldownMs = 0;
+    ThreadPool pool(sizing);
+    pthread_sigmask(SIG_UNBLOCK, &intMask, nullptr);
+
+    log_info("Chat server listening on port 8080...");
+    while (!g_stop.load()) {
+        new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t *)&addrlen);
+        if (new_socket < 0) {
+            if (errno == EINTR) continue;
+            log_error("accept failed: %s", std::strerror(errno));
+            log_shutdown();
+            exit(EXIT_FAILURE);
+        }
+        log_info("New connection accepted");
         pool.enqueue([new_socket]() { handle_client(new_socket); });
     }
 
-    if (new_socket < 0) {
-        perror("accept failed");
-        exit(EXIT_FAILURE);
-    }
-
+    log_info("SIGINT received, dumping stats...");
     close(server_fd);
-    return 0;
+    log_shutdown();
+    stats_dump_to_stdout();
+    stats_dump_to_file("logs/performance.txt");
+    // pool workers are still blocked in their clients' recv_all()
+    std::_Exit(0);
 }
@@ -1,27 +1,164 @@
 #include "thread_pool.h"
 #include "perf_stats.h"
+#include "cpu_affinity.h"
+#include "async_log.h"
 
-ThreadPool::ThreadPool(std::size_t threads) : stop(false) {
-    stats_init_threads(threads);   // tell stats module how many threads we have
-
-    for (std::size_t i = 0; i < threads; ++i) {
-        workers.emplace_back([this, i] {
-            while (true) {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(queue_mutex);
-                    condition.wait(lock, [this] {
-                        return stop || !tasks.empty();
-                    });
-                    if (stop && tasks.empty()) return;
-                    task = std::move(tasks.front());
-                    tasks.pop();
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+ThreadPool::ThreadPool(std::size_t threads, unsigned controlWeight,
+                       const std::vector<int>& cpus)
+    : ThreadPool(PoolSizing::fixed(threads), controlWeight, cpus) {}
+
+ThreadPool::ThreadPool(const PoolSizing& sizing, unsigned controlWeight,
+                       const std::vector<int>& cpus)
+    : sizing(sizing), cpus(cpus), stop(false),
+      controlWeight(controlWeight), controlStreak(0) {
+    this->sizing.minThreads = std::max<std::size_t>(1, sizing.minThreads);
+    this->sizing.maxThreads = std::max(this->sizing.minThreads, sizing.maxThreads);
+
+    stats_init_threads(this->sizing.maxThreads);   // one stats slot per possible worker
+    workers.resize(this->sizing.maxThreads);
+
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        for (std::size_t i = 0; i < this->sizing.minThreads; ++i) startWorker(i);
+    }
+    stats_record_pool_size(0, liveWorkers.load(), "start");
+
+    if (this->sizing.maxThreads > this->sizing.minThreads) {
+        controller = std::thread(&ThreadPool::controlLoop, this);
+    }
+}
+
+void ThreadPool::startWorker(std::size_t slot) {
+    WorkerSlot& w = workers[slot];
+    w.running = true;
+    w.exited  = false;
+    w.thread  = std::thread(&ThreadPool::workerLoop, this, slot);
+    liveWorkers++;
+}
+
+void ThreadPool::workerLoop(std::size_t i) {
+    int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+    if (cpu >= 0) {
+        if (pin_current_thread(cpu)) {
+            stats_set_thread_cpu(i, cpu);
+        } else {
+            log_warn("Worker %zu: cannot pin to cpu %d", i, cpu);
+        }
+    }
+
+    while (true) {
+        QueuedTask task;
+        std::size_t lane;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            ++idleWorkers;
+            condition.wait(lock, [this] {
+                return stop || retireRequests > 0 || !empty();
+            });
+            --idleWorkers;
+            if (stop && empty()) return;
+            if (retireRequests > 0 && !stop) {
+                // the controller asked for one fewer worker; take the request
+                --retireRequests;
+                workers[i].running = false;
+                workers[i].exited  = true;
+                liveWorkers--;
+                if (!empty()) condition.notify_one();   // don't swallow a task's wakeup
+                return;
+            }
+            lane = pickLane();
+            task = std::move(tasks[lane].front());
+            tasks[lane].pop();
+            queued[lane].store(tasks[lane].size());
+            running[lane]++;
+        }
+        auto waitedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - task.enqueuedAt).count();
+        stats_record_queue_wait(lane, waitedUs);
+        windowWaitUs.fetch_add(waitedUs, std::memory_order_relaxed);
+        windowTasks.fetch_add(1, std::memory_order_relaxed);
+        task.fn();
+        running[lane]--;
+        stats_record_task_completed(i);
+    }
+}
+
+void ThreadPool::controlLoop() {
+    unsigned hotSamples = 0;
+    auto quietSince  = Clock::now();
+    auto lastResize  = Clock::now();
+    const auto interval = std::chrono::milliseconds(sizing.intervalMs);
+
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while (!stop) {
+        controllerWake.wait_for(lock, interval, [this] { return stop; });
+        if (stop) break;
+
+        std::size_t depth = tasks[0].size() + tasks[1].size();
+        std::uint64_t n   = windowTasks.exchange(0);
+        std::uint64_t avgWaitUs = n ? windowWaitUs.exchange(0) / n : 0;
+        if (!n) windowWaitUs.store(0);
+
+        auto now = Clock::now();
+        bool hot = depth >= sizing.growQueueDepth || avgWaitUs >= sizing.growWaitUs;
+        hotSamples = hot ? hotSamples + 1 : 0;
+        if (depth > 0 || idleWorkers == 0) quietSince = now;
+
+        bool cooledDown = now - lastResize >= std::chrono::milliseconds(sizing.cooldownMs);
+        std::size_t live = liveWorkers.load();
+
+        if (hot && hotSamples >= sizing.growSamples && cooledDown &&
+            live < sizing.maxThreads) {
+            auto slot = std::find_if(workers.begin(), workers.end(),
+                                     [](const WorkerSlot& w) { return !w.running; });
+            if (slot != workers.end()) {
+                if (slot->exited) {
+                    // retired earlier; its thread has returned, join before reuse
+                    lock.unlock();
+                    slot->thread.join();
+                    lock.lock();
+                    slot->exited = false;
                 }
-                task();
-                stats_record_task_completed(i);
+                startWorker(static_cast<std::size_t>(slot - workers.begin()));
+                resized(live, live + 1,
+                        depth >= sizing.growQueueDepth ? "queue depth" : "queue wait");
+                hotSamples = 0;
+                lastResize = now;
             }
-        });
+        } else if (!hot && cooledDown && live > sizing.minThreads &&
+                   now - quietSince >= std::chrono::milliseconds(sizing.shrinkIdleMs)) {
+            ++retireRequests;
+            condition.notify_one();
+            resized(live, live - 1, "idle");
+            quietSince = now;
+            lastResize = now;
+        }
+    }
+}
+
+void ThreadPool::resized(std::size_t from, std::size_t to, const char* reason) {
+    stats_record_pool_size(from, to, reason);
+    log_info("Worker pool %zu -> %zu threads (%s)", from, to, reason);
+}
+
+std::size_t ThreadPool::pickLane() {
+    const std::size_t control = static_cast<std::size_t>(TaskLane::Control);
+    const std::size_t bulk    = static_cast<std::size_t>(TaskLane::Bulk);
+
+    if (tasks[control].empty()) {
+        controlStreak = 0;
+        return bulk;
+    }
+    if (!tasks[bulk].empty() && controlWeight > 0 && controlStreak >= controlWeight) {
+        controlStreak = 0;
+        return bulk;
     }
+    ++controlStreak;
+    return control;
 }
 
 ThreadPool::~ThreadPool() {
@@ -30,16 +167,20 @@ ThreadPool::~ThreadPool() {
         stop = true;
     }
     condition.notify_all();
+    controllerWake.notify_all();
+    if (controller.joinable()) controller.join();
     for (auto& worker : workers) {
-        worker.join();
+        if (worker.thread.joinable()) worker.thread.join();
     }
 }
 
-void ThreadPool::enqueue(std::function<void()> task) {
+void ThreadPool::enqueue(std::function<void()> task, TaskLane lane) {
+    std::size_t idx = static_cast<std::size_t>(lane);
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
-        tasks.push(std::move(task));
-        stats_record_queue_size(tasks.size());
+        tasks[idx].push(QueuedTask{std::move(task), Clock::now()});
+        queued[idx].store(tasks[idx].size());
+        stats_record_queue_size(tasks[0].size() + tasks[1].size());
     }
     condition.notify_one();
 }
@@ -6,20 +6,112 @@
 #include <condition_variable>
 #include <functional>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "../Shared/ring_queue.h"
+
+// Control: JOIN history replay, LIST_GROUPS replies and other SYSTEM work.
+// Bulk:    MESSAGE fan-out.
+enum class TaskLane : std::size_t { Control = 0, Bulk = 1 };
+
+// Bounds and thresholds for an adaptive pool. Every intervalMs a controller
+// thread looks at the queue depth and the average queue wait of tasks that
+// started in that interval:
+//   - growSamples hot intervals in a row (depth >= growQueueDepth or wait >=
+//     growWaitUs) add one worker, up to maxThreads;
+//   - shrinkIdleMs with an empty queue and an idle worker remove one, down
+//     to minThreads.
+// After any resize the controller waits cooldownMs before the next one.
+struct PoolSizing {
+    std::size_t   minThreads    = 2;
+    std::size_t   maxThreads    = 16;
+    std::size_t   growQueueDepth = 32;
+    std::uint64_t growWaitUs    = 2000;
+    unsigned      growSamples   = 2;
+    int           shrinkIdleMs  = 5000;
+    int           cooldownMs    = 1000;
+    int           intervalMs    = 100;
+
+    static PoolSizing fixed(std::size_t threads) {
+        PoolSizing s;
+        s.minThreads = s.maxThreads = threads;
+        return s;
+    }
+};
 
 class ThreadPool {
 public:
-    explicit ThreadPool(std::size_t threads);
+    // controlWeight = 0: strict priority, Bulk only runs when Control is empty.
+    // controlWeight = N: when both lanes are busy, run one Bulk task after
+    //                    every N Control tasks so bulk work can't starve.
+    //
+    // cpus: pin worker slot i to cpus[i % cpus.size()]; empty = let the OS schedule.
+    explicit ThreadPool(std::size_t threads, unsigned controlWeight = 0,
+                        const std::vector<int>& cpus = {});
+    // starts with sizing.minThreads workers and resizes within the bounds
+    explicit ThreadPool(const PoolSizing& sizing, unsigned controlWeight = 0,
+                        const std::vector<int>& cpus = {});
     ~ThreadPool();
 
-    void enqueue(std::function<void()> task);
+    void enqueue(std::function<void()> task, TaskLane lane = TaskLane::Bulk);
+
+    // tasks waiting for a worker in one lane
+    std::size_t queueSize(TaskLane lane = TaskLane::Bulk) const {
+        return queued[static_cast<std::size_t>(lane)].load();
+    }
+
+    // tasks of one lane a worker has taken and not yet finished. A task
+    // moves from queueSize to here under the queue lock, so it is always
+    // counted in one or the other.
+    std::size_t runningTasks(TaskLane lane) const {
+        return running[static_cast<std::size_t>(lane)].load();
+    }
+
+    std::size_t threadCount() const { return liveWorkers.load(); }
 
 private:
-    std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
+    static constexpr std::size_t kLanes = 2;
+
+    struct QueuedTask {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point enqueuedAt;
+    };
+
+    // a slot is reused after its worker retires, so stats keep a stable index
+    struct WorkerSlot {
+        std::thread thread;
+        bool running = false;     // guarded by queue_mutex
+        bool exited  = false;     // retired, waiting to be joined
+    };
+
+    PoolSizing sizing;
+    std::vector<int> cpus;
+    std::vector<WorkerSlot> workers;       // maxThreads slots
+    RingQueue<QueuedTask> tasks[kLanes];   // no per-task node allocation
     std::mutex queue_mutex;
     std::condition_variable condition;
     bool stop;
+    unsigned controlWeight;
+    unsigned controlStreak;                // Control tasks run since the last Bulk one
+    std::atomic<std::size_t> queued[kLanes] = {};   // mirrors tasks[i].size(), readable without the lock
+    std::atomic<std::size_t> running[kLanes] = {};
+
+    // adaptive sizing
+    std::size_t retireRequests = 0;        // guarded by queue_mutex
+    std::size_t idleWorkers = 0;           // guarded by queue_mutex
+    std::atomic<std::size_t> liveWorkers{0};
+    std::atomic<std::uint64_t> windowWaitUs{0};   // since the controller's last sample
+    std::atomic<std::uint64_t> windowTasks{0};
+    std::thread controller;
+    std::condition_variable controllerWake;
+
+    bool empty() const { return tasks[0].empty() && tasks[1].empty(); }
+    std::size_t pickLane();                // caller holds queue_mutex, !empty()
+    void startWorker(std::size_t slot);    // caller holds queue_mutex
+    void workerLoop(std::size_t slot);
+    void controlLoop();                    // adaptive sizing; only if min < max
+    void resized(std::size_t from, std::size_t to, const char* reason);
 };
 
 
@@ -0,0 +1,112 @@
+// Server/timer_wheel.cpp
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick)
+    : tick_(tick.count() > 0 ? tick : std::chrono::milliseconds(1)),
+      stop_(false), currentTick_(0), nextId_(1) {
+    thread_ = std::thread(&TimerWheel::run, this);
+}
+
+TimerWheel::~TimerWheel() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::milliseconds delay, Callback cb) {
+    // round up so a timer never fires early
+    std::uint64_t ticks = static_cast<std::uint64_t>(
+        (delay.count() + tick_.count() - 1) / tick_.count());
+    if (ticks == 0) ticks = 1;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    TimerId id = nextId_++;
+    std::uint64_t expiry = currentTick_ + ticks;
+    timers_.emplace(id, Timer{expiry, std::move(cb)});
+    place(id, expiry);
+    return id;
+}
+
+void TimerWheel::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    timers_.erase(id);   // the stale id left in its slot is skipped later
+}
+
+std::size_t TimerWheel::size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return timers_.size();
+}
+
+void TimerWheel::place(TimerId id, std::uint64_t expiry) {
+    std::uint64_t delta = expiry > currentTick_ ? expiry - currentTick_ : 0;
+
+    std::size_t level = 0;
+    while (level + 1 < kLevels && delta >= (std::uint64_t(1) << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+
+    // beyond the top level's span: park in the farthest slot, it will be
+    // re-placed on cascade and eventually reach its real slot
+    std::uint64_t maxSpan = std::uint64_t(1) << (kSlotBits * kLevels);
+    if (delta >= maxSpan) expiry = currentTick_ + maxSpan - 1;
+
+    std::size_t slot = (expiry >> (kSlotBits * level)) & (kSlots - 1);
+    wheels_[level][slot].push_back(id);
+}
+
+void TimerWheel::advance(std::vector<Callback>& due) {
+    ++currentTick_;
+
+    // when a lower wheel wraps, redistribute the next slot of the one above
+    for (std::size_t level = 1; level < kLevels; ++level) {
+        std::uint64_t lowerMask = (std::uint64_t(1) << (kSlotBits * level)) - 1;
+        if ((currentTick_ & lowerMask) != 0) break;
+
+        std::size_t slot = (currentTick_ >> (kSlotBits * level)) & (kSlots - 1);
+        Slot pending;
+        pending.swap(wheels_[level][slot]);
+        for (TimerId id : pending) {
+            auto it = timers_.find(id);
+            if (it != timers_.end()) place(id, it->second.expiry);
+        }
+    }
+
+    Slot& slot = wheels_[0][currentTick_ & (kSlots - 1)];
+    Slot keep;
+    for (TimerId id : slot) {
+        auto it = timers_.find(id);
+        if (it == timers_.end()) continue;          // cancelled
+        if (it->second.expiry > currentTick_) {     // parked beyond max span
+            keep.push_back(id);
+            continue;
+        }
+        due.push_back(std::move(it->second.cb));
+        timers_.erase(it);
+    }
+    slot.swap(keep);
+}
+
+void TimerWheel::run() {
+    auto next = std::chrono::steady_clock::now() + tick_;
+    std::vector<Callback> due;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            if (cv_.wait_until(lock, next, [this] { return stop_; })) return;
+
+            // catch up if the thread was descheduled for several ticks
+            auto now = std::chrono::steady_clock::now();
+            while (next <= now) {
+                advance(due);
+                next += tick_;
+            }
+        }
+
+        for (auto& cb : due) cb();
+        due.clear();
+    }
+}
@@ -0,0 +1,65 @@
+// Server/timer_wheel.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Hierarchical timing wheel driven by a single thread.
+//
+// Level 0 has one slot per tick; each higher level covers 64x the span of
+// the level below and is cascaded down as the lower wheel wraps, so
+// scheduling and cancelling are O(1) no matter how many timers are armed.
+// With the default 100 ms tick the four levels cover ~19 days.
+//
+// Callbacks run on the wheel thread, outside the wheel lock, and may
+// schedule or cancel timers themselves. They must not block.
+class TimerWheel {
+public:
+    using TimerId  = std::uint64_t;
+    using Callback = std::function<void()>;
+
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100));
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    TimerId schedule(std::chrono::milliseconds delay, Callback cb);
+    void cancel(TimerId id);            // no-op if already fired
+
+    std::size_t size() const;           // armed timers
+
+private:
+    static constexpr std::size_t kLevels   = 4;
+    static constexpr std::size_t kSlotBits = 6;
+    static constexpr std::size_t kSlots    = 1u << kSlotBits;
+
+    struct Timer {
+        std::uint64_t expiry;           // absolute tick
+        Callback cb;
+    };
+
+    using Slot = std::vector<TimerId>;
+
+    std::chrono::milliseconds tick_;
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_;
+    std::uint64_t currentTick_;
+    TimerId nextId_;
+    std::array<std::array<Slot, kSlots>, kLevels> wheels_;
+    std::unordered_map<TimerId, Timer> timers_;   // cancelled ids are simply erased
+    std::thread thread_;
+
+    void place(TimerId id, std::uint64_t expiry);  // caller holds mtx_
+    void advance(std::vector<Callback>& due);      // one tick, caller holds mtx_
+    void run();
+};
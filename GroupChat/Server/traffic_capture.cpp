@@ -0,0 +1,65 @@
+// Server/traffic_capture.cpp
+#include "traffic_capture.h"
+#include "../Shared/capture.h"
+#include "async_log.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+using Clock = std::chrono::steady_clock;
+
+static std::FILE* g_file = nullptr;
+static std::mutex g_fileMutex;
+static std::atomic<bool> g_enabled{false};
+static Clock::time_point g_openTime;
+
+bool capture_open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(g_fileMutex);
+    if (g_file) return true;
+
+    g_file = std::fopen(path.c_str(), "wb");
+    if (!g_file) {
+        log_error("capture_open: %s: %s", path.c_str(), std::strerror(errno));
+        return false;
+    }
+    // records are small; let stdio batch them into large writes
+    std::setvbuf(g_file, nullptr, _IOFBF, 1 << 16);
+
+    CaptureHeader hdr{};
+    std::memcpy(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic));
+    hdr.version    = CAPTURE_VERSION;
+    hdr.packetSize = sizeof(ChatPacket);
+    std::fwrite(&hdr, sizeof(hdr), 1, g_file);
+
+    g_openTime = Clock::now();
+    g_enabled.store(true);
+    return true;
+}
+
+void capture_record(std::uint32_t connId, const ChatPacket& pkt) {
+    if (!g_enabled.load(std::memory_order_relaxed)) return;
+
+    CaptureRecord rec{};
+    rec.connId    = connId;
+    rec.packet    = pkt;
+
+    // stamp under the lock so records land in the file in arrival order
+    std::lock_guard<std::mutex> lock(g_fileMutex);
+    if (!g_file) return;
+    rec.arrivalNs = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - g_openTime).count());
+    std::fwrite(&rec, sizeof(rec), 1, g_file);
+}
+
+void capture_close() {
+    g_enabled.store(false);
+    std::lock_guard<std::mutex> lock(g_fileMutex);
+    if (!g_file) return;
+    std::fclose(g_file);
+    g_file = nullptr;
+}
@@ -0,0 +1,13 @@
+// Server/traffic_capture.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "../Shared/protocol.h"
+
+// Optional recording of every inbound ChatPacket (see Shared/capture.h for
+// the file format). All calls are no-ops until capture_open() succeeds.
+
+bool capture_open(const std::string& path);   // false if the file can't be created
+void capture_record(std::uint32_t connId, const ChatPacket& pkt);
+void capture_close();                          // flush + close, safe to call twice
@@ -0,0 +1,172 @@
+// Server/transport.cpp
+#include "transport.h"
+#include "../Shared/shm_ring.h"
+#include "../Shared/utils.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <sys/socket.h>
+
+namespace {
+
+struct ShmChannel {
+    ShmSegment* seg;
+    std::mutex  sendMtx;     // many server threads produce into toClient
+
+    explicit ShmChannel(ShmSegment* s) : seg(s) {}
+    ~ShmChannel() { shm_segment_unmap(seg); }
+};
+
+// fd-indexed; the flag keeps the common (socket) path to one relaxed load
+constexpr int kMaxFds = 65536;
+std::atomic<bool>           g_isShm[kMaxFds];
+std::shared_ptr<ShmChannel> g_channels[kMaxFds];   // std::atomic_load/store only
+
+// One writer at a time per TCP socket. Fan-out workers, Control replies and
+// the liveness timer all write to the same connections, and a packet split
+// by another writer's bytes desyncs the client's stream. A std::mutex is
+// zero-initialised, so untouched slots cost no memory.
+std::mutex g_sendMtx[kMaxFds];
+
+std::mutex& sendMutexFor(int sock) {
+    return g_sendMtx[static_cast<unsigned>(sock) % kMaxFds];
+}
+
+std::shared_ptr<ShmChannel> channelFor(int sock) {
+    if (sock < 0 || sock >= kMaxFds) return nullptr;
+    if (!g_isShm[sock].load(std::memory_order_acquire)) return nullptr;
+    return std::atomic_load(&g_channels[sock]);
+}
+
+// peer closed (or we shut the socket down)?
+bool peerGone(int sock) {
+    char b;
+    ssize_t n = ::recv(sock, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+} // namespace
+
+bool transport_attach_shm(int sock, const std::string& name) {
+    if (sock < 0 || sock >= kMaxFds) return false;
+    ShmSegment* seg = shm_segment_map(name, false);
+    if (!seg) return false;
+    // both sides have it mapped now; don't leave the name behind in /dev/shm
+    ::shm_unlink(name.c_str());
+
+    std::atomic_store(&g_channels[sock], std::make_shared<ShmChannel>(seg));
+    g_isShm[sock].store(true, std::memory_order_release);
+    return true;
+}
+
+void transport_detach(int sock) {
+    if (sock < 0 || sock >= kMaxFds) return;
+    g_isShm[sock].store(false, std::memory_order_release);
+    std::atomic_store(&g_channels[sock], std::shared_ptr<ShmChannel>());
+}
+
+bool transport_send(int sock, const ChatPacket& pkt) {
+    auto ch = channelFor(sock);
+    if (!ch) {
+        std::lock_guard<std::mutex> lock(sendMutexFor(sock));
+        return send_all(sock, &pkt, sizeof(pkt));
+    }
+
+    std::unique_lock<std::mutex> lock(ch->sendMtx);
+    while (!shm_ring_push(ch->seg->toClient, pkt)) {
+        // ring full: the client is slow; wait like a full socket buffer would
+        lock.unlock();
+        if (peerGone(sock)) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        lock.lock();
+    }
+    shm_ring_wake(ch->seg->toClient, sock);
+    return true;
+}
+
+bool transport_send_batch(int sock, const ChatPacket* pkts, std::size_t count) {
+    auto ch = channelFor(sock);
+    if (!ch) {
+        std::lock_guard<std::mutex> lock(sendMutexFor(sock));
+        return send_all(sock, pkts, count * sizeof(ChatPacket));
+    }
+
+    // keep the ring to ourselves for the whole batch, even while it is full
+    std::lock_guard<std::mutex> lock(ch->sendMtx);
+    for (std::size_t i = 0; i < count; ++i) {
+        while (!shm_ring_push(ch->seg->toClient, pkts[i])) {
+            shm_ring_wake(ch->seg->toClient, sock);
+            if (peerGone(sock)) return false;
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+    if (count) shm_ring_wake(ch->seg->toClient, sock);
+    return true;
+}
+
+TrySend transport_try_send(int sock, const ChatPacket& pkt) {
+    auto ch = channelFor(sock);
+    if (ch) {
+        std::lock_guard<std::mutex> lock(ch->sendMtx);
+        if (!shm_ring_push(ch->seg->toClient, pkt)) return TrySend::WouldBlock;
+        shm_ring_wake(ch->seg->toClient, sock);
+        return TrySend::Sent;
+    }
+
+    // another thread is mid-packet: treat it like a full socket buffer
+    std::unique_lock<std::mutex> lock(sendMutexFor(sock), std::try_to_lock);
+    if (!lock.owns_lock()) return TrySend::WouldBlock;
+    ssize_t n = ::send(sock, &pkt, sizeof(pkt), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n == static_cast<ssize_t>(sizeof(pkt))) return TrySend::Sent;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return TrySend::WouldBlock;
+    return TrySend::Failed;   // error, or a partial write that desyncs the stream
+}
+
+bool transport_is_shm(int sock) {
+    return channelFor(sock) != nullptr;
+}
+
+RecvStatus transport_recv(int sock, RecvBuffer& buf) {
+    // keep a partial packet, drop everything already decoded
+    if (buf.begin > 0) {
+        std::memmove(buf.data.get(), buf.data.get() + buf.begin, buf.end - buf.begin);
+        buf.end -= buf.begin;
+        buf.begin = 0;
+    }
+
+    auto ch = channelFor(sock);
+    if (!ch) {
+        while (buf.end < sizeof(ChatPacket)) {
+            ssize_t n = ::recv(sock, buf.data.get() + buf.end, RecvBuffer::kCapacity - buf.end, 0);
+            if (n > 0) {
+                buf.end += static_cast<std::size_t>(n);
+            } else if (n < 0 && errno == EINTR) {
+                return RecvStatus::Interrupted;
+            } else {
+                return RecvStatus::Closed;
+            }
+        }
+        return RecvStatus::Packet;
+    }
+
+    ShmRing& ring = ch->seg->toServer;
+    char wake[64];
+    while (true) {
+        ChatPacket pkt;
+        while (buf.end + sizeof(pkt) <= RecvBuffer::kCapacity && shm_ring_pop(ring, pkt)) {
+            std::memcpy(buf.data.get() + buf.end, &pkt, sizeof(pkt));
+            buf.end += sizeof(pkt);
+        }
+        if (buf.end > 0) return RecvStatus::Packet;
+        if (!shm_ring_prepare_sleep(ring)) continue;
+        // block until the client pushes (one wake byte) or disconnects (EOF)
+        ssize_t n = ::recv(sock, wake, sizeof(wake), 0);
+        if (n == 0) return RecvStatus::Closed;
+        if (n < 0) return errno == EINTR ? RecvStatus::Interrupted : RecvStatus::Closed;
+    }
+}
@@ -0,0 +1,63 @@
+// Server/transport.h
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include "../Shared/protocol.h"
+
+// Per-connection packet I/O. Most connections are plain stream sockets
+// (TCP or Unix domain) and these calls reduce to send_all/recv_all; a
+// connection that has attached a shared-memory segment (see
+// Shared/shm_ring.h) moves its packets through the rings instead, with the
+// socket only used for wakeups and EOF.
+
+// Map the client's segment and switch `sock` to shared-memory mode.
+bool transport_attach_shm(int sock, const std::string& name);
+
+// Forget any shared-memory state for `sock`; call before closing it.
+void transport_detach(int sock);
+
+// Blocking: false once the peer is gone. Safe from any thread: writes to
+// one connection are serialised, so packets never interleave.
+bool transport_send(int sock, const ChatPacket& pkt);
+// Same, for a multi-packet reply: the packets go out back to back, with no
+// other thread's packet between them.
+bool transport_send_batch(int sock, const ChatPacket* pkts, std::size_t count);
+
+// Per-connection receive buffer. One transport_recv() takes everything the
+// kernel (or the shm ring) has ready, up to the capacity, and the caller
+// then decodes every complete packet in it before reading again -- a burst
+// of packets costs one recv() instead of one or more per packet.
+struct RecvBuffer {
+    static constexpr std::size_t kCapacity = 64 * 1024;   // ~249 packets
+
+    std::unique_ptr<char[]> data{new char[kCapacity]};
+    std::size_t begin = 0;          // unread bytes are [begin, end)
+    std::size_t end   = 0;
+
+    // next complete packet, if one is buffered
+    bool next(ChatPacket& pkt) {
+        if (end - begin < sizeof(ChatPacket)) return false;
+        std::memcpy(&pkt, data.get() + begin, sizeof(ChatPacket));
+        begin += sizeof(ChatPacket);
+        return true;
+    }
+    // nothing buffered, not even part of a packet
+    bool empty() const { return begin == end; }
+};
+
+// Blocking until `buf` holds at least one complete packet. Interrupted: a
+// signal arrived first; whatever was read so far (at most part of a
+// packet) stays in `buf`.
+enum class RecvStatus { Packet, Closed, Interrupted };
+RecvStatus transport_recv(int sock, RecvBuffer& buf);
+
+bool transport_is_shm(int sock);
+
+// Never blocks: WouldBlock also when another thread is writing to `sock`.
+// Failed means the stream can't be used any more
+// (e.g. a partial TCP write) and the caller should shut the socket down.
+enum class TrySend { Sent, WouldBlock, Failed };
+TrySend transport_try_send(int sock, const ChatPacket& pkt);
@@ -1,8 +1,9 @@
 #pragma once
 #include <vector>
 #include <cstddef>
+#include <memory>
 
-template <typename T>
+template <typename T, typename Alloc = std::allocator<T>>
 class CircularCache {
 public:
     explicit CircularCache(std::size_t capacity = 50)
@@ -24,7 +25,7 @@ public:
     }
 
 private:
-    std::vector<T> buf_;
+    std::vector<T, Alloc> buf_;
     std::size_t capacity_;
     std::size_t size_;
     std::size_t head_;
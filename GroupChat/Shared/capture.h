@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include "protocol.h"
+
+// On-disk format for traffic captures written by chat_server --capture and
+// read back by the replay tool.
+//
+//   CaptureHeader                       (once, at the start of the file)
+//   CaptureRecord, CaptureRecord, ...   (one per inbound ChatPacket)
+//
+// All integers are little-endian host order; the embedded ChatPacket is kept
+// exactly as it arrived on the wire (network-order fields).
+
+#pragma pack(push, 1)
+struct CaptureHeader {
+    char     magic[4];    // "GCAP"
+    uint16_t version;     // CAPTURE_VERSION
+    uint16_t packetSize;  // sizeof(ChatPacket) when the file was written
+};
+
+struct CaptureRecord {
+    uint32_t   connId;    // server-assigned connection id (accept order)
+    uint64_t   arrivalNs; // nanoseconds since the capture was opened
+    ChatPacket packet;
+};
+#pragma pack(pop)
+
+constexpr char     CAPTURE_MAGIC[4] = {'G', 'C', 'A', 'P'};
+constexpr uint16_t CAPTURE_VERSION  = 1;
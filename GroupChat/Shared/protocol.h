@@ -3,7 +3,7 @@
 
 #pragma pack(push, 1)
 struct ChatPacket {
-    uint8_t  type;        // 0 = JOIN, 1 = MESSAGE, 2 = LEAVE, 3 = LIST_GROUPS, 4 = SYSTEM
+    uint8_t  type;        // 0 = JOIN, 1 = MESSAGE, 2 = LEAVE, 3 = LIST_GROUPS, 4 = SYSTEM, 5 = HEARTBEAT, 6 = SHM_ATTACH, 7-11 = NODE_*, 12 = SEARCH
     uint16_t groupID;     // network order on the wire
     uint32_t timestamp;   // epoch seconds, network order
     char     payload[256];// UTF-8 text, null-terminated if shorter than 256
@@ -17,4 +17,17 @@ namespace ChatType {
     constexpr uint8_t LEAVE      = 2;
     constexpr uint8_t LIST_GROUPS= 3;
     constexpr uint8_t SYSTEM     = 4;
+    constexpr uint8_t HEARTBEAT  = 5;   // server ping / client pong, no payload
+    constexpr uint8_t SHM_ATTACH = 6;   // payload = shm segment name (Unix socket only)
+
+    // server <-> server (see Server/cluster.h)
+    constexpr uint8_t NODE_HELLO       = 7;    // payload = sender's node id
+    constexpr uint8_t NODE_RELAY       = 8;    // client MESSAGE, non-owner -> owner
+    constexpr uint8_t NODE_FANOUT      = 9;    // ordered MESSAGE, owner -> subscriber
+    constexpr uint8_t NODE_SUBSCRIBE   = 10;   // sender has members in groupID
+    constexpr uint8_t NODE_UNSUBSCRIBE = 11;
+
+    // client -> server: payload = query words; server -> client: one match
+    // per packet, newest first, then a SYSTEM summary
+    constexpr uint8_t SEARCH = 12;
 }
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+// FIFO with the std::queue interface, backed by a ring buffer that doubles
+// when full and never shrinks. Unlike std::deque it stops allocating once it
+// has grown to the peak depth, so steady-state push/pop is allocation-free.
+template <typename T>
+class RingQueue {
+public:
+    explicit RingQueue(std::size_t initialCapacity = 64)
+        : buf_(initialCapacity ? initialCapacity : 1), head_(0), size_(0) {}
+
+    bool empty() const { return size_ == 0; }
+    std::size_t size() const { return size_; }
+
+    void push(T&& value) {
+        if (size_ == buf_.size()) grow();
+        buf_[(head_ + size_) % buf_.size()] = std::move(value);
+        ++size_;
+    }
+
+    T& front() { return buf_[head_]; }
+
+    void pop() {
+        buf_[head_] = T();              // release whatever the slot held
+        head_ = (head_ + 1) % buf_.size();
+        --size_;
+    }
+
+private:
+    std::vector<T> buf_;
+    std::size_t head_;
+    std::size_t size_;
+
+    void grow() {
+        std::vector<T> bigger(buf_.size() * 2);
+        for (std::size_t i = 0; i < size_; ++i) {
+            bigger[i] = std::move(buf_[(head_ + i) % buf_.size()]);
+        }
+        buf_.swap(bigger);
+        head_ = 0;
+    }
+};
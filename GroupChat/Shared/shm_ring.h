@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "protocol.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Shared-memory transport for clients on the same host as the server.
+//
+// The client creates a segment holding two single-producer/single-consumer
+// rings of ChatPackets (client->server and server->client) and tells the
+// server its name with a SHM_ATTACH packet over a Unix domain socket. From
+// then on packets only travel through the rings; the socket is kept for
+// lifetime (EOF = disconnect) and for wakeups:
+//
+//   consumer: sleeping = 1, re-check ring, then block in recv() on the socket
+//   producer: push, then if sleeping.exchange(0) write one byte to the socket
+//
+// so a busy connection exchanges packets without any syscalls at all.
+//
+// Both processes share the layout below, so it must stay trivially laid out.
+
+constexpr uint32_t SHM_MAGIC        = 0x47434852;  // "GCHR"
+constexpr uint32_t SHM_RING_PACKETS = 1024;        // per direction, power of two
+
+struct ShmRing {
+    std::atomic<uint64_t> head;       // next slot the consumer reads
+    char pad0[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail;       // next slot the producer writes
+    char pad1[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint32_t> sleeping;   // consumer is (about to be) blocked in recv()
+    char pad2[64 - sizeof(std::atomic<uint32_t>)];
+    ChatPacket slots[SHM_RING_PACKETS];
+};
+
+struct ShmSegment {
+    uint32_t magic;
+    uint32_t packetSize;
+    ShmRing  toServer;
+    ShmRing  toClient;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory rings need address-free atomics");
+
+inline bool shm_ring_push(ShmRing& r, const ChatPacket& pkt) {
+    uint64_t tail = r.tail.load(std::memory_order_relaxed);
+    if (tail - r.head.load(std::memory_order_acquire) >= SHM_RING_PACKETS) return false;
+    std::memcpy(&r.slots[tail % SHM_RING_PACKETS], &pkt, sizeof(pkt));
+    r.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+inline bool shm_ring_pop(ShmRing& r, ChatPacket& pkt) {
+    uint64_t head = r.head.load(std::memory_order_relaxed);
+    if (head == r.tail.load(std::memory_order_acquire)) return false;
+    std::memcpy(&pkt, &r.slots[head % SHM_RING_PACKETS], sizeof(pkt));
+    r.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+inline bool shm_ring_empty(const ShmRing& r) {
+    return r.head.load(std::memory_order_acquire) == r.tail.load(std::memory_order_acquire);
+}
+
+// Producer side of the wakeup protocol: call after one or more pushes.
+inline void shm_ring_wake(ShmRing& r, int sock) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (r.sleeping.exchange(0) != 0) {
+        // never block: if the socket is full the consumer has wakeups queued anyway
+        char b = 1;
+        ssize_t n = ::send(sock, &b, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+        (void)n;   // a dead peer is noticed by its recv() side
+    }
+}
+
+// Consumer side: announce we're about to sleep; returns false (and cancels
+// the announcement) if data arrived in the meantime.
+inline bool shm_ring_prepare_sleep(ShmRing& r) {
+    r.sleeping.store(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!shm_ring_empty(r)) {
+        r.sleeping.store(0);
+        return false;
+    }
+    return true;
+}
+
+// Creates (client) or opens (server) a segment. Returns nullptr on failure.
+inline ShmSegment* shm_segment_map(const std::string& name, bool create) {
+    int flags = create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR;
+    int fd = ::shm_open(name.c_str(), flags, 0600);
+    if (fd < 0) return nullptr;
+    if (create && ::ftruncate(fd, sizeof(ShmSegment)) < 0) {
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    void* mem = ::mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) return nullptr;
+
+    auto* seg = static_cast<ShmSegment*>(mem);
+    if (create) {
+        // fresh pages are zero-filled, which is a valid empty ring
+        seg->packetSize = sizeof(ChatPacket);
+        seg->magic      = SHM_MAGIC;
+    } else if (seg->magic != SHM_MAGIC || seg->packetSize != sizeof(ChatPacket)) {
+        ::munmap(mem, sizeof(ShmSegment));
+        return nullptr;
+    }
+    return seg;
+}
+
+inline void shm_segment_unmap(ShmSegment* seg) {
+    if (seg) ::munmap(seg, sizeof(ShmSegment));
+}
@@ -0,0 +1,96 @@
+// Shared/thread_ring.h
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Per-thread single-producer rings with one consumer.
+//
+// Each thread that calls local() gets its own fixed ring of N records,
+// registered on first use and retired when the thread exits. The owning
+// thread fills a slot with claim()/publish() and takes no lock and makes no
+// syscall; a full ring makes claim() fail and the caller drops the record.
+// The consumer's drain() hands every queued record to a callback and forgets
+// rings whose thread has exited once they are empty. The registry mutex is
+// only taken on registration and by drain().
+//
+// The thread-local handle belongs to the instantiation, so keep one set per
+// record type (async_log and msg_trace each have their own).
+template <typename T, std::size_t N>
+class ThreadRingSet {
+public:
+    struct Ring {
+        std::uint32_t threadId;
+        std::atomic<std::uint64_t> head{0};   // next slot the consumer reads
+        std::atomic<std::uint64_t> tail{0};   // next slot the owner writes
+        std::atomic<bool> retired{false};     // owner thread has exited
+        T slots[N];
+
+        explicit Ring(std::uint32_t id) : threadId(id) {}
+
+        // owner only: the next free slot, or null when the consumer is behind
+        T* claim() {
+            std::uint64_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) >= N) return nullptr;
+            return &slots[t % N];
+        }
+        // owner only: makes the slot from claim() visible to the consumer
+        void publish() {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    };
+
+    // the calling thread's ring, registered on first use
+    Ring& local() {
+        thread_local Handle handle(*this);
+        return *handle.ring;
+    }
+
+    // consumer only: fn(const T&) for every queued record, oldest first per ring
+    template <typename Fn>
+    void drain(Fn&& fn) {
+        std::vector<std::shared_ptr<Ring>> rings;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            rings = rings_;
+        }
+
+        for (auto& r : rings) {
+            std::uint64_t head = r->head.load(std::memory_order_relaxed);
+            std::uint64_t tail = r->tail.load(std::memory_order_acquire);
+            for (; head < tail; ++head) fn(r->slots[head % N]);
+            r->head.store(head, std::memory_order_release);
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                    [](const std::shared_ptr<Ring>& r) {
+                                        return r->retired.load(std::memory_order_acquire) &&
+                                               r->head.load() == r->tail.load();
+                                    }),
+                     rings_.end());
+    }
+
+private:
+    // registers this thread's ring and retires it at thread exit; the ring
+    // itself lives until the consumer has drained it
+    struct Handle {
+        std::shared_ptr<Ring> ring;
+
+        explicit Handle(ThreadRingSet& set)
+            : ring(std::make_shared<Ring>(set.nextThreadId_++)) {
+            std::lock_guard<std::mutex> lock(set.mtx_);
+            set.rings_.push_back(ring);
+        }
+        ~Handle() { ring->retired.store(true, std::memory_order_release); }
+    };
+
+    std::mutex                         mtx_;    // registration + drain, never per record
+    std::vector<std::shared_ptr<Ring>> rings_;
+    std::atomic<std::uint32_t>         nextThreadId_{1};
+};
@@ -0,0 +1,77 @@
+// Tests/buffer_pool_tests.cpp
+#include "test_harness.h"
+#include "../Server/buffer_pool.h"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// a counter from BufferPool::dump(), e.g. "slab refills"
+std::uint64_t dumpCounter(const BufferPool& pool, const std::string& key) {
+    std::ostringstream os;
+    pool.dump(os);
+    std::string s = os.str();
+    std::size_t pos = s.find(key + "=");
+    if (pos == std::string::npos) return ~std::uint64_t(0);
+    return std::stoull(s.substr(pos + key.size() + 1));
+}
+
+constexpr std::size_t kBlocksPerSlab = 64;   // BufferPool::kBlocksPerSlab
+
+} // namespace
+
+// a freed block is the next one handed out from its size class
+TEST(buffer_pool, freed_block_is_reused) {
+    BufferPool pool("test");
+    void* a = pool.allocate(100);
+    pool.deallocate(a, 100);
+    void* b = pool.allocate(120);   // same 128 B class
+    CHECK(a == b);
+    void* c = pool.allocate(40);    // 64 B class: a different list
+    CHECK(c != b);
+    pool.deallocate(b, 120);
+    pool.deallocate(c, 40);
+}
+
+// one slab per kBlocksPerSlab blocks; once warm, no more refills
+TEST(buffer_pool, slabs_reused_once_warm) {
+    BufferPool pool("test");
+    std::vector<void*> blocks;
+    for (std::size_t i = 0; i < kBlocksPerSlab; ++i) blocks.push_back(pool.allocate(256));
+    CHECK(dumpCounter(pool, "slab refills") == 1);
+    blocks.push_back(pool.allocate(256));
+    CHECK(dumpCounter(pool, "slab refills") == 2);
+
+    for (void* p : blocks) pool.deallocate(p, 256);
+    CHECK(dumpCounter(pool, "in use") == 0);
+
+    for (int round = 0; round < 10; ++round) {
+        for (void*& p : blocks) p = pool.allocate(256);
+        for (void* p : blocks) pool.deallocate(p, 256);
+    }
+    CHECK(dumpCounter(pool, "slab refills") == 2);
+}
+
+// the blocks carved from one slab never overlap
+TEST(buffer_pool, blocks_are_distinct) {
+    BufferPool pool("test");
+    std::vector<char*> blocks;
+    for (std::size_t i = 0; i < kBlocksPerSlab; ++i) {
+        char* p = static_cast<char*>(pool.allocate(64));
+        for (char* q : blocks) CHECK(p >= q + 64 || q >= p + 64);
+        blocks.push_back(p);
+    }
+    for (char* p : blocks) pool.deallocate(p, 64);
+}
+
+TEST(buffer_pool, oversize_falls_back_to_heap) {
+    BufferPool pool("test");
+    void* p = pool.allocate(8192);
+    CHECK(p != nullptr);
+    CHECK(dumpCounter(pool, "oversize") == 1);
+    CHECK(dumpCounter(pool, "slab refills") == 0);
+    pool.deallocate(p, 8192);
+}
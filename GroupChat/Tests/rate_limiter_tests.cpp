@@ -0,0 +1,59 @@
+// Tests/rate_limiter_tests.cpp
+#include "test_harness.h"
+#include "../Server/rate_limiter.h"
+
+#include <chrono>
+
+using Clock = TokenBucket::Clock;
+using std::chrono::milliseconds;
+
+// the bucket starts full: exactly `burst` tokens, then nothing
+TEST(token_bucket, starts_with_burst) {
+    TokenBucket bucket(10.0, 5.0);
+    Clock::time_point now = Clock::now();
+    for (int i = 0; i < 5; ++i) CHECK(bucket.tryConsume(now));
+    CHECK(!bucket.tryConsume(now));
+}
+
+// 100 ms at 10 tokens/sec is one token
+TEST(token_bucket, refills_at_rate) {
+    TokenBucket bucket(10.0, 5.0);
+    Clock::time_point now = Clock::now();
+    while (bucket.tryConsume(now)) {}
+
+    CHECK(!bucket.tryConsume(now + milliseconds(50)));
+    CHECK(bucket.tryConsume(now + milliseconds(100)));
+    CHECK(!bucket.tryConsume(now + milliseconds(100)));
+    CHECK(bucket.tryConsume(now + milliseconds(300)));
+    CHECK(bucket.tryConsume(now + milliseconds(300)));
+    CHECK(!bucket.tryConsume(now + milliseconds(300)));
+}
+
+// a long pause refills no further than the burst
+TEST(token_bucket, refill_capped_at_burst) {
+    TokenBucket bucket(10.0, 5.0);
+    Clock::time_point now = Clock::now();
+    while (bucket.tryConsume(now)) {}
+
+    Clock::time_point later = now + std::chrono::seconds(60);
+    int granted = 0;
+    while (bucket.tryConsume(later)) ++granted;
+    CHECK(granted == 5);
+}
+
+// a clock that steps backwards neither adds nor removes tokens
+TEST(token_bucket, ignores_time_going_backwards) {
+    TokenBucket bucket(10.0, 2.0);
+    Clock::time_point now = Clock::now() + milliseconds(10);
+    CHECK(bucket.tryConsume(now));
+    CHECK(bucket.tryConsume(now - milliseconds(500)));
+    CHECK(!bucket.tryConsume(now - milliseconds(500)));
+}
+
+TEST(token_bucket, groups_are_independent) {
+    GroupRateLimiter limiter(1.0, 2.0);
+    CHECK(limiter.tryConsume(1));
+    CHECK(limiter.tryConsume(1));
+    CHECK(!limiter.tryConsume(1));
+    CHECK(limiter.tryConsume(2));
+}
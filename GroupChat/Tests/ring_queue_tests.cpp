@@ -0,0 +1,58 @@
+// Tests/ring_queue_tests.cpp
+#include "test_harness.h"
+#include "ring_queue.h"
+
+#include <memory>
+
+TEST(ring_queue, fifo_across_growth) {
+    RingQueue<int> q(2);
+    for (int i = 0; i < 100; ++i) q.push(int(i));
+    CHECK(q.size() == 100);
+    for (int i = 0; i < 100; ++i) {
+        CHECK(q.front() == i);
+        q.pop();
+    }
+    CHECK(q.empty());
+}
+
+// grow while head_ is mid-buffer: the wrapped tail must be unrolled in order
+TEST(ring_queue, grows_while_wrapped) {
+    RingQueue<int> q(4);
+    for (int i = 0; i < 4; ++i) q.push(int(i));
+    q.pop();
+    q.pop();
+    for (int i = 4; i < 10; ++i) q.push(int(i));   // wraps, then doubles
+    for (int i = 2; i < 10; ++i) {
+        CHECK(q.front() == i);
+        q.pop();
+    }
+    CHECK(q.empty());
+}
+
+TEST(ring_queue, zero_capacity_still_works) {
+    RingQueue<int> q(0);
+    q.push(7);
+    q.push(8);
+    CHECK(q.front() == 7);
+    q.pop();
+    CHECK(q.front() == 8);
+}
+
+// pop() must drop the slot's value now, not when the slot is reused
+TEST(ring_queue, pop_releases_value) {
+    RingQueue<std::shared_ptr<int>> q(8);
+    auto p = std::make_shared<int>(1);
+    q.push(std::shared_ptr<int>(p));
+    CHECK(p.use_count() == 2);
+    q.pop();
+    CHECK(p.use_count() == 1);
+}
+
+TEST(ring_queue, move_only_values) {
+    RingQueue<std::unique_ptr<int>> q(1);
+    for (int i = 0; i < 5; ++i) q.push(std::make_unique<int>(i));
+    for (int i = 0; i < 5; ++i) {
+        CHECK(*q.front() == i);
+        q.pop();
+    }
+}
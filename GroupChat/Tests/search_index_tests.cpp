@@ -0,0 +1,143 @@
+// Tests/search_index_tests.cpp
+#include "test_harness.h"
+#include "../Server/search_index.h"
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+ChatPacket message(const std::string& text, uint32_t timestamp = 0) {
+    ChatPacket pkt{};
+    pkt.type      = ChatType::MESSAGE;
+    pkt.timestamp = htonl(timestamp);
+    std::snprintf(pkt.payload, sizeof(pkt.payload), "%s", text.c_str());
+    return pkt;
+}
+
+std::string msgText(int i) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "m%05d", i);
+    return buf;
+}
+
+// payload texts of every match, newest first
+std::vector<std::string> texts(SearchIndex& index, uint16_t groupId,
+                               const std::string& query, std::size_t& total) {
+    std::vector<std::string> out;
+    for (const ChatPacket& pkt : index.query(groupId, query, 100000, total)) {
+        out.emplace_back(pkt.payload);
+    }
+    return out;
+}
+
+} // namespace
+
+TEST(search_index, tokenize_normalises) {
+    auto t = SearchIndex::tokenize("Hello, hello WORLD a b2 x-ray!");
+    CHECK((t == std::vector<std::string>{"b2", "hello", "ray", "world"}));
+
+    std::string longWord(40, 'q');
+    auto l = SearchIndex::tokenize(longWord.c_str());
+    CHECK(l.size() == 1 && l[0].size() == 32);
+}
+
+TEST(search_index, all_terms_newest_first) {
+    SearchIndex index;
+    index.add(1, message("red apple", 10));
+    index.add(1, message("green apple", 20));
+    index.add(1, message("red cherry", 30));
+    index.add(1, message("red apple pie", 40));
+    index.add(2, message("red apple elsewhere", 50));
+
+    std::size_t total = 0;
+    auto hits = index.query(1, "apple RED", 10, total);
+    CHECK(total == 2);
+    CHECK(hits.size() == 2);
+    if (hits.size() == 2) {
+        CHECK(std::string(hits[0].payload) == "red apple pie");
+        CHECK(ntohl(hits[0].timestamp) == 40);
+        CHECK(hits[0].type == ChatType::SEARCH);
+        CHECK(ntohs(hits[0].groupID) == 1);
+        CHECK(std::string(hits[1].payload) == "red apple");
+    }
+
+    hits = index.query(1, "red", 1, total);
+    CHECK(total == 3 && hits.size() == 1);
+
+    index.query(1, "banana", 10, total);
+    CHECK(total == 0);
+    index.query(3, "red", 10, total);
+    CHECK(total == 0);
+    index.query(1, "!", 10, total);
+    CHECK(total == 0);
+}
+
+// deltas of 128 and more take several varint bytes; ids must decode exactly
+TEST(search_index, varint_postings_decode) {
+    SearchIndex index(64 << 20);
+    for (int i = 0; i < 20000; ++i) {
+        std::string text = msgText(i);
+        if (i == 0 || i == 1 || i == 130 || i == 16500 || i == 19999) text += " rare";
+        if (i % 3 == 0) text += " third";
+        index.add(7, message(text));
+    }
+
+    std::size_t total = 0;
+    auto rare = texts(index, 7, "rare", total);
+    CHECK(total == 5);
+    CHECK((rare == std::vector<std::string>{msgText(19999) + " rare", msgText(16500) + " rare third",
+                                            msgText(130) + " rare", msgText(1) + " rare",
+                                            msgText(0) + " rare third"}));
+
+    auto both = texts(index, 7, "rare third", total);
+    CHECK((both == std::vector<std::string>{msgText(16500) + " rare third",
+                                            msgText(0) + " rare third"}));
+
+    texts(index, 7, "third", total);
+    CHECK(total == 6667);
+}
+
+// past the budget the oldest quarter goes at once; what's left is always
+// the newest contiguous run of messages
+TEST(search_index, evicts_oldest_quarter) {
+    const std::size_t budget = 16 << 10;
+    SearchIndex index(budget);
+    index.add(2, message("other group common"));
+
+    int added = 0;
+    std::size_t kept = 0;
+    std::size_t prevKept = 0;
+    bool evicted = false;
+    while (added < 2000) {
+        index.add(1, message(msgText(added) + " common"));
+        ++added;
+        texts(index, 1, "common", kept);
+        if (kept < prevKept + 1) {
+            evicted = true;
+            // one quarter (rounded down) of what was there before this add
+            CHECK(kept == prevKept + 1 - (prevKept + 1) / 4);
+            break;
+        }
+        prevKept = kept;
+    }
+    CHECK(evicted);
+    CHECK(index.memoryBytes() <= budget + (1 << 10));
+
+    std::size_t total = 0;
+    auto all = texts(index, 1, "common", total);
+    CHECK(all.size() == kept);
+    for (std::size_t i = 0; i < all.size(); ++i) {
+        CHECK(all[i] == msgText(added - 1 - static_cast<int>(i)) + " common");
+    }
+    texts(index, 1, msgText(0), total);
+    CHECK(total == 0);
+    texts(index, 1, msgText(added - 1), total);
+    CHECK(total == 1);
+
+    // eviction is per group
+    texts(index, 2, "common", total);
+    CHECK(total == 1);
+}
@@ -0,0 +1,27 @@
+// Tests/test_harness.h
+#pragma once
+
+#include <cstdio>
+
+// Minimal assert-style unit tests.
+//
+// TEST(suite, name) registers a test; CHECK(cond) reports a failure and lets
+// the test carry on. unit_tests runs every test of the suite named on the
+// command line (all of them without one) and exits non-zero on any failure,
+// so each suite is its own ctest entry.
+
+using TestFn = void (*)();
+
+bool test_register(const char* suite, const char* name, TestFn fn);
+void test_fail(const char* file, int line, const char* expr);
+
+#define TEST(suite, name)                                                   \
+    static void suite##_##name();                                           \
+    static const bool suite##_##name##_registered =                         \
+        test_register(#suite, #name, suite##_##name);                       \
+    static void suite##_##name()
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) test_fail(__FILE__, __LINE__, #cond);                  \
+    } while (0)
@@ -0,0 +1,50 @@
+// Tests/test_main.cpp
+#include "test_harness.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct TestCase {
+    const char* suite;
+    const char* name;
+    TestFn      fn;
+};
+
+// function-local so registration from other files' static initialisers is safe
+std::vector<TestCase>& registry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+int g_failures = 0;
+
+} // namespace
+
+bool test_register(const char* suite, const char* name, TestFn fn) {
+    registry().push_back(TestCase{suite, name, fn});
+    return true;
+}
+
+void test_fail(const char* file, int line, const char* expr) {
+    std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expr);
+    ++g_failures;
+}
+
+int main(int argc, char** argv) {
+    const char* only = argc > 1 ? argv[1] : nullptr;
+    int run = 0;
+    for (const TestCase& t : registry()) {
+        if (only && std::strcmp(only, t.suite) != 0) continue;
+        int before = g_failures;
+        t.fn();
+        std::printf("%-6s %s.%s\n", g_failures == before ? "ok" : "FAILED", t.suite, t.name);
+        ++run;
+    }
+    if (run == 0) {
+        std::fprintf(stderr, "no tests in suite %s\n", only ? only : "(all)");
+        return 1;
+    }
+    return g_failures == 0 ? 0 : 1;
+}
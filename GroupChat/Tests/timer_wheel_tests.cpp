@@ -0,0 +1,105 @@
+// Tests/timer_wheel_tests.cpp
+#include "test_harness.h"
+#include "../Server/timer_wheel.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+namespace {
+
+// polls `done` for up to `limit`; true if it turned true
+template <typename Pred>
+bool waitFor(Pred done, milliseconds limit) {
+    auto deadline = Clock::now() + limit;
+    while (!done()) {
+        if (Clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+}
+
+} // namespace
+
+TEST(timer_wheel, fires_in_expiry_order) {
+    TimerWheel wheel(milliseconds(1));
+    std::mutex mtx;
+    std::vector<int> order;
+    auto record = [&](int v) {
+        return [&mtx, &order, v] {
+            std::lock_guard<std::mutex> lock(mtx);
+            order.push_back(v);
+        };
+    };
+    wheel.schedule(milliseconds(30), record(3));
+    wheel.schedule(milliseconds(10), record(1));
+    wheel.schedule(milliseconds(20), record(2));
+
+    CHECK(waitFor([&] { return wheel.size() == 0; }, milliseconds(2000)));
+    std::lock_guard<std::mutex> lock(mtx);
+    CHECK((order == std::vector<int>{1, 2, 3}));
+}
+
+// 64+ ticks lands on level 1 and has to cascade down to level 0 to fire;
+// it must not fire early on the way
+TEST(timer_wheel, cascades_from_upper_level) {
+    TimerWheel wheel(milliseconds(1));
+    std::atomic<bool> fired{false};
+    Clock::time_point start = Clock::now();
+    Clock::time_point firedAt;
+    wheel.schedule(milliseconds(150), [&] {
+        firedAt = Clock::now();
+        fired = true;
+    });
+
+    CHECK(waitFor([&] { return fired.load(); }, milliseconds(2000)));
+    if (fired) CHECK(firedAt - start >= milliseconds(150));
+    CHECK(wheel.size() == 0);
+}
+
+// past the top level's span (64^4 ticks) a timer is parked and re-placed;
+// it stays armed rather than firing at the parking slot
+TEST(timer_wheel, beyond_span_stays_armed) {
+    TimerWheel wheel(milliseconds(1));
+    std::atomic<bool> fired{false};
+    wheel.schedule(milliseconds(std::int64_t(1) << 25), [&] { fired = true; });
+    std::this_thread::sleep_for(milliseconds(100));
+    CHECK(!fired);
+    CHECK(wheel.size() == 1);
+}
+
+TEST(timer_wheel, cancel_prevents_firing) {
+    TimerWheel wheel(milliseconds(1));
+    std::atomic<int> fired{0};
+    TimerWheel::TimerId near = wheel.schedule(milliseconds(20), [&] { fired++; });
+    TimerWheel::TimerId far  = wheel.schedule(milliseconds(120), [&] { fired++; });   // level 1
+    wheel.schedule(milliseconds(40), [&] { fired += 100; });
+    CHECK(wheel.size() == 3);
+
+    wheel.cancel(near);
+    wheel.cancel(far);
+    CHECK(wheel.size() == 1);
+
+    std::this_thread::sleep_for(milliseconds(250));
+    CHECK(fired == 100);
+    CHECK(wheel.size() == 0);
+
+    wheel.cancel(near);   // already gone: no-op
+    CHECK(wheel.size() == 0);
+}
+
+// callbacks run outside the wheel lock, so they may re-arm themselves
+TEST(timer_wheel, callback_can_reschedule) {
+    TimerWheel wheel(milliseconds(1));
+    std::atomic<int> runs{0};
+    std::function<void()> tick = [&] {
+        if (++runs < 3) wheel.schedule(milliseconds(5), tick);
+    };
+    wheel.schedule(milliseconds(5), tick);
+    CHECK(waitFor([&] { return runs.load() == 3; }, milliseconds(2000)));
+}